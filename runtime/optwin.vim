@@ -1011,6 +1011,14 @@ call append("$", "maxmem\tmaximum amount of memory in Kbyte used for one buffer"
 call append("$", " \tset mm=" . &mm)
 call append("$", "maxmemtot\tmaximum amount of memory in Kbyte used for all buffers")
 call append("$", " \tset mmt=" . &mmt)
+if has("mmap_load")
+  call append("$", "mmapsize\tminimal size in Kbyte of a file to map into memory")
+  call append("$", " \tset mms=" . &mms)
+  if has("persistent_undo")
+    call append("$", "mmapindex\tstore the line index of a mapped file in 'undodir'")
+    call <SID>BinOptionG("mmi", &mmi)
+  endif
+endif
 
 
 call <SID>Header("command line editing")
@@ -616,6 +616,8 @@ static void f_matchend __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_matchlist __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_matchstr __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_max __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_memfilestats __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_memlinestats __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_min __ARGS((typval_T *argvars, typval_T *rettv));
 #ifdef vim_mkdir
 static void f_mkdir __ARGS((typval_T *argvars, typval_T *rettv));
@@ -642,6 +644,7 @@ static void f_pyeval __ARGS((typval_T *argvars, typval_T *rettv));
 #endif
 static void f_range __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_readfile __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_regcachestats __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_reltime __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_reltimestr __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_remote_expr __ARGS((typval_T *argvars, typval_T *rettv));
@@ -8005,6 +8008,8 @@ static struct fst
     {"matchlist",	2, 4, f_matchlist},
     {"matchstr",	2, 4, f_matchstr},
     {"max",		1, 1, f_max},
+    {"memfilestats",	0, 1, f_memfilestats},
+    {"memlinestats",	0, 1, f_memlinestats},
     {"min",		1, 1, f_min},
 #ifdef vim_mkdir
     {"mkdir",		1, 3, f_mkdir},
@@ -8031,6 +8036,7 @@ static struct fst
 #endif
     {"range",		1, 3, f_range},
     {"readfile",	1, 3, f_readfile},
+    {"regcachestats",	0, 0, f_regcachestats},
     {"reltime",		0, 2, f_reltime},
     {"reltimestr",	1, 1, f_reltimestr},
     {"remote_expr",	2, 3, f_remote_expr},
@@ -12328,6 +12334,9 @@ f_has(argvars, rettv)
 #ifdef FEAT_SESSION
 	"mksession",
 #endif
+#ifdef FEAT_MMAP_LOAD
+	"mmap_load",
+#endif
 #ifdef FEAT_MODIFY_FNAME
 	"modify_fname",
 #endif
@@ -14233,6 +14242,63 @@ f_max(argvars, rettv)
     max_min(argvars, rettv, TRUE);
 }
 
+/*
+ * "memfilestats([{expr}])" function
+ */
+    static void
+f_memfilestats(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    buf_T	*buf;
+
+    if (rettv_dict_alloc(rettv) == FAIL)
+	return;
+    if (argvars[0].v_type == VAR_UNKNOWN)
+	mf_stats(NULL, rettv->vval.v_dict);
+    else
+    {
+	(void)get_tv_number(&argvars[0]);   /* issue errmsg if type error */
+	++emsg_off;
+	buf = get_buf_tv(&argvars[0], FALSE);
+	--emsg_off;
+	if (buf != NULL && buf->b_ml.ml_mfp != NULL)
+	    mf_stats(buf->b_ml.ml_mfp, rettv->vval.v_dict);
+    }
+}
+
+/*
+ * "memlinestats([{expr}])" function
+ */
+    static void
+f_memlinestats(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    buf_T	*buf;
+    dict_T	*dict;
+
+    if (argvars[0].v_type == VAR_UNKNOWN)
+	buf = curbuf;
+    else
+    {
+	(void)get_tv_number(&argvars[0]);   /* issue errmsg if type error */
+	++emsg_off;
+	buf = get_buf_tv(&argvars[0], FALSE);
+	--emsg_off;
+    }
+
+    if (rettv_dict_alloc(rettv) == FAIL || buf == NULL
+						|| buf->b_ml.ml_mfp == NULL)
+	return;
+    dict = rettv->vval.v_dict;
+    dict_add_nr_str(dict, "lines", (long)buf->b_ml.ml_line_count, NULL);
+    dict_add_nr_str(dict, "locked", buf->b_ml.ml_find_locked, NULL);
+    dict_add_nr_str(dict, "stack", buf->b_ml.ml_find_stack, NULL);
+    dict_add_nr_str(dict, "index", buf->b_ml.ml_find_index, NULL);
+    dict_add_nr_str(dict, "root", buf->b_ml.ml_find_root, NULL);
+}
+
 /*
  * "min()" function
  */
@@ -14924,6 +14990,18 @@ list2proftime(arg, tm)
 }
 #endif /* FEAT_RELTIME */
 
+/*
+ * "regcachestats()" function
+ */
+    static void
+f_regcachestats(argvars, rettv)
+    typval_T	*argvars UNUSED;
+    typval_T	*rettv;
+{
+    if (rettv_dict_alloc(rettv) == OK)
+	regcache_stats(rettv->vval.v_dict);
+}
+
 /*
  * "reltime()" function
  */
@@ -771,6 +771,8 @@ EX(CMD_redrawstatus,	"redrawstatus",	ex_redrawstatus,
 			BANG|TRLBAR|CMDWIN),
 EX(CMD_registers,	"registers",	ex_display,
 			EXTRA|NOTRLCOM|TRLBAR|CMDWIN),
+EX(CMD_regtime,		"regtime",	ex_regtime,
+			NEEDARG|WORD1|TRLBAR|CMDWIN),
 EX(CMD_resize,		"resize",	ex_resize,
 			RANGE|NOTADR|TRLBAR|WORD1),
 EX(CMD_retab,		"retab",	ex_retab,
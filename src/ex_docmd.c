@@ -245,6 +245,9 @@ static void	ex_popup __ARGS((exarg_T *eap));
 #if !defined(FEAT_SYN_HL) || !defined(FEAT_PROFILE)
 # define ex_syntime		ex_ni
 #endif
+#ifndef FEAT_PROFILE
+# define ex_regtime		ex_ni
+#endif
 #ifndef FEAT_SPELL
 # define ex_spell		ex_ni
 # define ex_mkspell		ex_ni
@@ -3996,6 +3999,7 @@ set_one_cmd_context(xp, buff)
 	    break;
 #endif
 #if defined(FEAT_PROFILE)
+	case CMD_regtime:
 	case CMD_syntime:
 	    xp->xp_context = EXPAND_SYNTIME;
 	    xp->xp_pattern = arg;
@@ -501,6 +501,14 @@
 # define FEAT_BYTEOFF
 #endif
 
+/*
+ * +mmap_load		Map huge files into memory and load their lines
+ *			lazily, see 'mmapsize'.
+ */
+#if defined(FEAT_NORMAL) && defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+# define FEAT_MMAP_LOAD
+#endif
+
 /*
  * +wildignore		'wildignore' and 'backupskip' options
  *			Needed for Unix to make "crontab -e" work.
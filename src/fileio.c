@@ -23,6 +23,9 @@
 
 #define BUFSIZE		8192	/* size of normal write buffer */
 #define SMBUFSIZE	256	/* size of emergency write buffer */
+#define WRITEBUFSIZE	1048576	/* size of write buffer for many lines */
+#define WRITEBIG_LINES	10000	/* use WRITEBUFSIZE for this many lines */
+#define READ_PROGRESS_MSEC 500L /* give progress message after this */
 
 #ifdef FEAT_CRYPT
 /* crypt_magic[0] is pkzip crypt, crypt_magic[1] is sha2+blowfish */
@@ -54,6 +57,15 @@ static char_u *readfile_charconvert __ARGS((char_u *fname, char_u *fenc, int *fd
 #ifdef FEAT_VIMINFO
 static void check_marks_read __ARGS((void));
 #endif
+#ifdef FEAT_MMAP_LOAD
+static mlmap_T *readfile_mmap __ARGS((char_u *addr, size_t size, struct stat *st, int fileformat, int try_unix, int try_dos, int try_mac, int check_utf8, int bin));
+# ifdef FEAT_PERSISTENT_UNDO
+static mlmap_T *mmap_index_read __ARGS((char_u *addr, size_t size, struct stat *st, int key));
+static void mmap_index_write __ARGS((mlmap_T *map, size_t size, struct stat *st, int key));
+static size_t mmap_index_get __ARGS((FILE *fp));
+static size_t mmap_index_hash __ARGS((char_u *addr, size_t len, size_t *index, size_t count));
+# endif
+#endif
 #ifdef FEAT_CRYPT
 static int crypt_method_from_magic __ARGS((char *ptr, int len));
 static char_u *check_for_cryptkey __ARGS((char_u *cryptkey, char_u *ptr, long *sizep, off_t *filesizep, int newfile, char_u *fname, int *did_ask));
@@ -255,6 +267,17 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, eap, flags)
 #ifdef FEAT_PERSISTENT_UNDO
     context_sha256_T sha_ctx;
     int		read_undo_file = FALSE;
+#endif
+#ifdef FEAT_MMAP_LOAD
+    char_u	*map_addr = NULL;	/* file mapped into memory */
+    size_t	map_size = 0;
+    int		map_tried = FALSE;
+    mlmap_T	*map = NULL;		/* set when the mapping is used */
+    struct stat	st_map;
+#endif
+#ifdef FEAT_RELTIME
+    int		show_progress;		/* may give a progress message */
+    proftime_T	progress_tm;		/* when to give the next one */
 #endif
     int		split = 0;		/* number of split lines */
 #define UNKNOWN	 0x0fffffff		/* file size is unknown */
@@ -1178,8 +1201,123 @@ retry:
 #endif
     }
 
+#ifdef FEAT_MMAP_LOAD
+    /*
+     * When editing a big file map it into memory, the lines are then only
+     * copied when they are used.  Anything that requires changing the text
+     * while reading it is done the normal way.
+     */
+    if (p_mms > 0 && !map_tried && !skip_read
+	    && newfile && wasempty && from == 0
+	    && lines_to_skip == 0 && lines_to_read == MAXLNUM
+	    && !filtering && !read_stdin && !read_buffer && !recoverymode
+# ifdef FEAT_PERSISTENT_UNDO
+	    && !read_undo_file
+# endif
+# ifdef FEAT_NETBEANS_INTG
+	    && !netbeans_active()
+# endif
+	    )
+    {
+	map_tried = TRUE;
+	if (mch_fstat(fd, &st_map) == 0 && S_ISREG(st_map.st_mode)
+		&& st_map.st_size >= (off_t)p_mms * 1024
+		&& (off_t)(size_t)st_map.st_size == st_map.st_size)
+	{
+	    map_size = (size_t)st_map.st_size;
+	    map_addr = mch_map_file(fd, map_size);
+	}
+    }
+    if (map_addr != NULL)
+    {
+# ifdef FEAT_MBYTE
+	int	blen;
+
+	if (fio_flags == FIO_UCSBOM && !curbuf->b_p_bin
+		&& check_for_bom(map_addr, (long)map_size, &blen,
+							     FIO_ALL) == NULL)
+	{
+	    /* No BOM detected: retry with next encoding, keep the mapping. */
+	    advance_fenc = TRUE;
+	    goto retry;
+	}
+# endif
+	if (
+# ifdef FEAT_MBYTE
+		!converted
+		&& (curbuf->b_p_bin || check_for_bom(map_addr, (long)map_size,
+						    &blen, FIO_ALL) == NULL) &&
+# endif
+# ifdef FEAT_CRYPT
+		STRNCMP(map_addr, crypt_magic_head,
+					       STRLEN(crypt_magic_head)) != 0 &&
+# endif
+		(map = readfile_mmap(map_addr, map_size, &st_map, fileformat,
+				     try_unix, try_dos, try_mac,
+# ifdef FEAT_MBYTE
+				     enc_utf8 && !curbuf->b_p_bin,
+# else
+				     FALSE,
+# endif
+				     curbuf->b_p_bin)) != NULL)
+	{
+	    map->mm_size = map_size;
+	    map->mm_dev = st_map.st_dev;
+	    map->mm_ino = st_map.st_ino;
+	    map_addr = NULL;		/* owned by "map" now */
+
+	    if (fileformat == EOL_UNKNOWN)
+	    {
+		fileformat = map->mm_fileformat;
+		if (set_options)
+		    set_fileformat(fileformat, OPT_LOCAL);
+	    }
+	    lnum = map->mm_lines;
+	    if (map->mm_noeol)
+	    {
+		if (set_options)
+		    curbuf->b_p_eol = FALSE;
+		read_no_eol_lnum = lnum;
+	    }
+	    filesize = (off_t)map_size;
+	    ml_map_attach(curbuf, map);
+	    goto failed;
+	}
+	mch_unmap_file(map_addr, map_size);
+	map_addr = NULL;
+    }
+#endif
+
+#ifdef FEAT_RELTIME
+    /* Reading a big file may take a while.  When it takes longer than
+     * READ_PROGRESS_MSEC tell the user how far we got. */
+    show_progress = (newfile && !read_stdin && !read_buffer && !filtering
+						    && !(flags & READ_DUMMY));
+    if (show_progress)
+	profile_setlimit(READ_PROGRESS_MSEC, &progress_tm);
+#endif
+
     while (!error && !got_int)
     {
+#ifdef FEAT_RELTIME
+	if (show_progress && profile_passed_limit(&progress_tm))
+	{
+	    struct stat	st_cur;
+	    off_t	pos = lseek(fd, (off_t)0L, SEEK_CUR);
+	    char_u	buf[20];
+
+	    if (pos > 0 && mch_fstat(fd, &st_cur) == 0 && st_cur.st_size > 0)
+	    {
+		/* avoid overflow for a 32 bit off_t */
+		vim_snprintf((char *)buf, sizeof(buf), "%d%%",
+			pos > 1000000L ? (int)(pos / (st_cur.st_size / 100 + 1))
+				       : (int)(pos * 100 / st_cur.st_size));
+		filemess(old_curbuf, sfname, buf, 0);
+	    }
+	    profile_setlimit(READ_PROGRESS_MSEC, &progress_tm);
+	}
+#endif
+
 	/*
 	 * We allocate as much space for the file as we can get, plus
 	 * space for the old line plus room for one terminating NUL.
@@ -1746,6 +1884,7 @@ retry:
 		int	u8c;
 		char_u	*dest;
 		char_u	*tail = NULL;
+		size_t	n;
 
 		/*
 		 * "enc_utf8" set: Convert Unicode or Latin1 to UTF-8.
@@ -1816,6 +1955,37 @@ retry:
 
 		while (p > ptr)
 		{
+		    /* Fast paths for a run of ASCII characters, they are the
+		     * same in UTF-8. */
+		    if (enc_utf8 && fio_flags == FIO_LATIN1)
+		    {
+			n = vim_ascii_len_back(ptr, (size_t)(p - ptr));
+			if (n > 0)
+			{
+			    p -= n;
+			    dest -= n;
+			    mch_memmove(dest, p, n);
+			    continue;
+			}
+		    }
+		    else if (enc_utf8 && (fio_flags & (FIO_UCS2 | FIO_UTF16)))
+		    {
+			if (fio_flags & FIO_ENDIAN_L)
+			    while (p > ptr && p[-1] == 0 && p[-2] < 0x80)
+			    {
+				*--dest = p[-2];
+				p -= 2;
+			    }
+			else
+			    while (p > ptr && p[-2] == 0 && p[-1] < 0x80)
+			    {
+				*--dest = p[-1];
+				p -= 2;
+			    }
+			if (p == ptr)
+			    break;
+		    }
+
 		    if (fio_flags & FIO_LATIN1)
 			u8c = *--p;
 		    else if (fio_flags & (FIO_UCS2 | FIO_UTF16))
@@ -2026,6 +2196,9 @@ retry:
 			else
 			    p += l - 1;
 		    }
+		    else
+			/* Skip over ASCII quickly. */
+			p += vim_ascii_len(p, (size_t)todo) - 1;
 		}
 		if (p < ptr + size && !incomplete_tail)
 		{
@@ -2057,18 +2230,13 @@ rewind_retry:
 		/* First try finding a NL, for Dos and Unix */
 		if (try_dos || try_unix)
 		{
-		    for (p = ptr; p < ptr + size; ++p)
-		    {
-			if (*p == NL)
-			{
-			    if (!try_unix
-				    || (try_dos && p > ptr && p[-1] == CAR))
-				fileformat = EOL_DOS;
-			    else
-				fileformat = EOL_UNIX;
-			    break;
-			}
-		    }
+		    p = (char_u *)memchr(ptr, NL, (size_t)size);
+		    if (p == NULL)
+			p = ptr + size;
+		    else if (!try_unix || (try_dos && p > ptr && p[-1] == CAR))
+			fileformat = EOL_DOS;
+		    else
+			fileformat = EOL_UNIX;
 
 		    /* Don't give in to EOL_UNIX if EOL_MAC is more likely */
 		    if (fileformat == EOL_UNIX && try_mac)
@@ -2080,13 +2248,8 @@ rewind_retry:
 			    ;
 			if (p >= ptr)
 			{
-			    for (p = ptr; p < ptr + size; ++p)
-			    {
-				if (*p == NL)
-				    try_unix++;
-				else if (*p == CAR)
-				    try_mac++;
-			    }
+			    try_unix += vim_memcnt(ptr, NL, (size_t)size);
+			    try_mac += vim_memcnt(ptr, CAR, (size_t)size);
 			    if (try_mac > try_unix)
 				fileformat = EOL_MAC;
 			}
@@ -2154,12 +2317,18 @@ rewind_retry:
 	}
 	else
 	{
-	    --ptr;
-	    while (++ptr, --size >= 0)
+	    while (size > 0)
 	    {
-		if ((c = *ptr) != NUL && c != NL)  /* catch most common case */
-		    continue;
-		if (c == NUL)
+		/* Skip to the next NL or NUL, most bytes are neither. */
+		p = vim_memchr2(ptr, NL, NUL, (size_t)size);
+		if (p == NULL)
+		{
+		    ptr += size;
+		    break;
+		}
+		size -= (long)(p - ptr) + 1;
+		ptr = p;
+		if (*ptr == NUL)
 		    *ptr = NL;	/* NULs are replaced by newlines! */
 		else
 		{
@@ -2218,6 +2387,7 @@ rewind_retry:
 			--skip_count;
 		    line_start = ptr + 1;
 		}
+		++ptr;
 	    }
 	}
 	linerest = (long)(ptr - line_start);
@@ -2302,6 +2472,10 @@ failed:
     }
 #endif
     vim_free(buffer);
+#ifdef FEAT_MMAP_LOAD
+    if (map_addr != NULL)			/* mapping wasn't used */
+	mch_unmap_file(map_addr, map_size);
+#endif
 
 #ifdef HAVE_DUP
     if (read_stdin)
@@ -2329,13 +2503,19 @@ failed:
 	/* need to delete the last line, which comes from the empty buffer */
 	if (newfile && wasempty && !(curbuf->b_ml.ml_flags & ML_EMPTY))
 	{
+#ifdef FEAT_MMAP_LOAD
+	    /* the lines of a mapped file replaced the empty line */
+	    if (map == NULL)
+#endif
+	    {
 #ifdef FEAT_NETBEANS_INTG
-	    netbeansFireChanges = 0;
+		netbeansFireChanges = 0;
 #endif
-	    ml_delete(curbuf->b_ml.ml_line_count, FALSE);
+		ml_delete(curbuf->b_ml.ml_line_count, FALSE);
 #ifdef FEAT_NETBEANS_INTG
-	    netbeansFireChanges = 1;
+		netbeansFireChanges = 1;
 #endif
+	    }
 	    --linecnt;
 	}
 	linecnt = curbuf->b_ml.ml_line_count - linecnt;
@@ -2673,17 +2853,413 @@ readfile_linenr(linecnt, p, endp)
     char_u	*p;		/* start of more bytes read */
     char_u	*endp;		/* end of more bytes read */
 {
-    char_u	*s;
     linenr_T	lnum;
 
     lnum = curbuf->b_ml.ml_line_count - linecnt + 1;
-    for (s = p; s < endp; ++s)
-	if (*s == '\n')
-	    ++lnum;
+    if (endp > p)
+	lnum += vim_memcnt(p, '\n', (size_t)(endp - p));
     return lnum;
 }
 #endif
 
+#ifdef FEAT_MMAP_LOAD
+/*
+ * Check if the "size" bytes of a file mapped at "addr" can be used as the
+ * buffer text as they are and build the line index for them.
+ * "st" is the result of stat() for the file.
+ * "fileformat" is the format to use, EOL_UNKNOWN to detect it like
+ * readfile() does.  When "check_utf8" is set the text must be valid UTF-8.
+ * When 'mmapindex' is set the line index is read from or written to an index
+ * file.
+ * Returns NULL when the file has to be read the normal way.
+ */
+    static mlmap_T *
+readfile_mmap(addr, size, st, fileformat, try_unix, try_dos, try_mac,
+							     check_utf8, bin)
+    char_u	*addr;
+    size_t	size;
+    struct stat	*st UNUSED;
+    int		fileformat;
+    int		try_unix;
+    int		try_dos;
+    int		try_mac;
+    int		check_utf8;
+    int		bin;
+{
+    char_u	*end = addr + size;
+    char_u	*p;
+    size_t	off;
+    linenr_T	lines = 0;
+    int		noeol;
+    garray_T	ga;
+    mlmap_T	*map;
+# ifdef FEAT_PERSISTENT_UNDO
+    /* The arguments the result depends on. */
+    int		key = (fileformat + 1) + (try_unix << 3) + (try_dos << 4)
+		       + (try_mac << 5) + (check_utf8 << 6) + (bin << 7);
+
+    if (p_mmi && (map = mmap_index_read(addr, size, st, key)) != NULL)
+	return map;
+# endif
+
+    /* Without a NL it's one line or a Mac file, not worth it. */
+    p = (char_u *)memchr(addr, NL, size);
+    if (p == NULL)
+	return NULL;
+
+    if (fileformat == EOL_UNKNOWN)
+    {
+	if (!try_dos && !try_unix)
+	    return NULL;
+	if (!try_unix || (try_dos && p > addr && p[-1] == CAR))
+	    fileformat = EOL_DOS;
+	else
+	{
+	    fileformat = EOL_UNIX;
+	    /* Counting CRs to decide on Mac format is left to the normal
+	     * way of reading. */
+	    if (try_mac && memchr(addr, CAR, (size_t)(p - addr)) != NULL)
+		return NULL;
+	}
+    }
+    if (fileformat == EOL_MAC)
+	return NULL;
+
+#ifdef FEAT_MBYTE
+    if (check_utf8)
+	for (p = addr; p < end; )
+	{
+	    if (*p < 0x80)
+		p += vim_ascii_len(p, (size_t)(end - p));
+	    else
+	    {
+		int l = utf_ptr2len_len(p, (int)(end - p < 8 ? end - p : 8));
+
+		if (l == 1 || l > end - p)
+		    return NULL;	/* illegal byte, let readfile() decide */
+		p += l;
+	    }
+	}
+#endif
+
+    /* Remember the offset of every MLMAP_STEP'th line. */
+    ga_init2(&ga, (int)sizeof(size_t), 1024);
+    for (off = 0; off < size; off = (size_t)(p - addr) + 1)
+    {
+	if (lines % MLMAP_STEP == 0)
+	{
+	    if (ga_grow(&ga, 1) == FAIL)
+		goto fail;
+	    ((size_t *)ga.ga_data)[ga.ga_len++] = off;
+	}
+	p = (char_u *)memchr(addr + off, NL, size - off);
+	if (p == NULL)
+	    break;
+	if (p - (addr + off) >= MAXCOL)
+	    goto fail;
+	/* A NL without a CR in a DOS file needs a retry or an error message,
+	 * leave that to readfile(). */
+	if (fileformat == EOL_DOS && (p == addr + off || p[-1] != CAR))
+	    goto fail;
+	++lines;
+    }
+
+    noeol = (off < size);
+    if (noeol)
+    {
+	if (size - off >= MAXCOL)
+	    goto fail;
+	/* In Dos format ignore a trailing CTRL-Z, unless 'binary' set. */
+	if (!bin && fileformat == EOL_DOS && size - off == 1
+							&& addr[off] == Ctrl_Z)
+	{
+	    noeol = FALSE;
+	    size = off;
+	}
+	else
+	    ++lines;
+    }
+
+    map = (mlmap_T *)alloc_clear((unsigned)sizeof(mlmap_T));
+    if (map == NULL)
+	goto fail;
+    map->mm_addr = addr;
+    map->mm_len = size;
+    map->mm_index = (size_t *)ga.ga_data;
+    map->mm_lines = lines;
+    map->mm_fileformat = fileformat;
+    map->mm_noeol = noeol;
+# ifdef FEAT_PERSISTENT_UNDO
+    if (p_mmi)
+	mmap_index_write(map, size, st, key);
+# endif
+    return map;
+
+fail:
+    ga_clear(&ga);
+    return NULL;
+}
+
+# ifdef FEAT_PERSISTENT_UNDO
+#  define MI_START_MAGIC	"Vim\237MaPiX"	/* magic at start of index file */
+#  define MI_START_MAGIC_LEN	9
+#  define MI_VERSION		1	/* 2-byte index file version number */
+#  define MI_EXT		".mi~"	/* appended to the name in 'undodir' */
+#  define MI_SAMPLES		64	/* number of lines checked */
+#  define MI_SAMPLE_LEN		64	/* bytes hashed for each checked line */
+
+/*
+ * Get the line index for the file mapped at "addr" with "size" bytes from
+ * its index file, see 'mmapindex'.  "st" is the result of stat() for the
+ * file, "key" stands for the arguments of readfile_mmap().
+ * Returns NULL when there is no index file or it doesn't match the file.
+ */
+    static mlmap_T *
+mmap_index_read(addr, size, st, key)
+    char_u	*addr;
+    size_t	size;
+    struct stat	*st;
+    int		key;
+{
+    char_u	*file_name;
+    FILE	*fp;
+    char_u	magic[MI_START_MAGIC_LEN];
+    int		fileformat;
+    int		noeol;
+    size_t	lines;
+    size_t	len;
+    size_t	count;
+    size_t	hash;
+    size_t	minstep;
+    size_t	step;
+    size_t	i;
+    size_t	*index = NULL;
+    mlmap_T	*map = NULL;
+
+    file_name = u_get_udir_file_name(curbuf->b_ffname, TRUE,
+					 (char_u *)MI_EXT, (char_u *)MI_EXT);
+    if (file_name == NULL)
+	return NULL;
+    fp = mch_fopen((char *)file_name, "r");
+    if (fp == NULL)
+    {
+	vim_free(file_name);
+	return NULL;
+    }
+
+    /* The file must not have changed since the index was written. */
+    if (fread(magic, MI_START_MAGIC_LEN, 1, fp) != 1
+	    || memcmp(magic, MI_START_MAGIC, MI_START_MAGIC_LEN) != 0
+	    || get2c(fp) != MI_VERSION
+	    || getc(fp) != (int)sizeof(size_t)
+	    || mmap_index_get(fp) != size
+	    || mmap_index_get(fp) != (size_t)st->st_dev
+	    || mmap_index_get(fp) != (size_t)st->st_ino
+	    || get8ctime(fp) != st->st_mtime
+	    || get2c(fp) != key)
+	goto theend;
+    fileformat = getc(fp);
+    noeol = getc(fp);
+    lines = mmap_index_get(fp);
+    len = mmap_index_get(fp);
+    count = mmap_index_get(fp);
+    hash = mmap_index_get(fp);
+    if ((fileformat != EOL_UNIX && fileformat != EOL_DOS)
+	    || (noeol != FALSE && noeol != TRUE)
+	    || lines == 0 || lines > (size_t)MAXLNUM
+	    || len == 0 || len > size
+	    || count != (lines + MLMAP_STEP - 1) / MLMAP_STEP)
+	goto theend;
+
+    index = (size_t *)lalloc((long_u)(count * sizeof(size_t)), FALSE);
+    if (index == NULL)
+	goto theend;
+    /* Every entry is MLMAP_STEP line breaks after the previous one, each
+     * being at least one byte, two in a DOS file. */
+    minstep = fileformat == EOL_DOS ? 2 * MLMAP_STEP : MLMAP_STEP;
+    for (i = 0; i < count; ++i)
+    {
+	index[i] = mmap_index_get(fp);
+	if (i == 0 ? index[i] != 0
+		   : (index[i] < index[i - 1] + minstep || index[i] >= len))
+	    goto theend;
+    }
+    if (ferror(fp) || feof(fp))
+	goto theend;
+
+    /* Cheap check that the text still matches: a sample of the indexed
+     * lines must start after a line break and the start of these lines
+     * must hash to the same value as when the index was written. */
+    step = count / MI_SAMPLES + 1;
+    for (i = 1; i < count; i += step)
+	if (addr[index[i] - 1] != NL
+		|| (fileformat == EOL_DOS && addr[index[i] - 2] != CAR))
+	    goto theend;
+    if (!noeol && addr[len - 1] != NL)
+	goto theend;
+    if (mmap_index_hash(addr, len, index, count) != hash)
+	goto theend;
+
+    map = (mlmap_T *)alloc_clear((unsigned)sizeof(mlmap_T));
+    if (map == NULL)
+	goto theend;
+    map->mm_addr = addr;
+    map->mm_len = len;
+    map->mm_index = index;
+    map->mm_lines = (linenr_T)lines;
+    map->mm_fileformat = fileformat;
+    map->mm_noeol = noeol;
+    index = NULL;
+    if (p_verbose > 0)
+    {
+	verbose_enter();
+	smsg((char_u *)_("Using line index file: %s"), file_name);
+	verbose_leave();
+    }
+
+theend:
+    fclose(fp);
+    vim_free(index);
+    vim_free(file_name);
+    return map;
+}
+
+/*
+ * Write the line index of "map" to the index file for the current buffer.
+ * "size", "st" and "key" are what mmap_index_read() checks.
+ * Failing is silent, the index is only a cache.
+ */
+    static void
+mmap_index_write(map, size, st, key)
+    mlmap_T	*map;
+    size_t	size;
+    struct stat	*st;
+    int		key;
+{
+    char_u	*file_name;
+    char_u	mbuf[MI_START_MAGIC_LEN];
+    int		fd;
+    FILE	*fp;
+    size_t	count;
+    size_t	i;
+    int		error;
+
+    file_name = u_get_udir_file_name(curbuf->b_ffname, FALSE,
+					 (char_u *)MI_EXT, (char_u *)MI_EXT);
+    if (file_name == NULL)
+	return;
+
+    /* Only overwrite an existing file when it is an index file. */
+    if (mch_getperm(file_name) >= 0)
+    {
+	fd = mch_open((char *)file_name, O_RDONLY|O_EXTRA, 0);
+	if (fd < 0)
+	    goto theend;
+	error = (read_eintr(fd, mbuf, MI_START_MAGIC_LEN) < MI_START_MAGIC_LEN
+		|| memcmp(mbuf, MI_START_MAGIC, MI_START_MAGIC_LEN) != 0);
+	close(fd);
+	if (error)
+	    goto theend;
+	mch_remove(file_name);
+    }
+
+    fd = mch_open((char *)file_name,
+			    O_CREAT|O_EXTRA|O_WRONLY|O_EXCL|O_NOFOLLOW,
+						   (int)(st->st_mode & 0666));
+    if (fd < 0)
+	goto theend;
+    fp = fdopen(fd, "w");
+    if (fp == NULL)
+    {
+	close(fd);
+	mch_remove(file_name);
+	goto theend;
+    }
+    if (p_verbose > 0)
+    {
+	verbose_enter();
+	smsg((char_u *)_("Writing line index file: %s"), file_name);
+	verbose_leave();
+    }
+
+    count = (map->mm_lines + MLMAP_STEP - 1) / MLMAP_STEP;
+    fwrite(MI_START_MAGIC, (size_t)MI_START_MAGIC_LEN, (size_t)1, fp);
+    put_bytes(fp, (long_u)MI_VERSION, 2);
+    putc((int)sizeof(size_t), fp);
+    put_bytes(fp, (long_u)size, (int)sizeof(size_t));
+    put_bytes(fp, (long_u)(size_t)st->st_dev, (int)sizeof(size_t));
+    put_bytes(fp, (long_u)(size_t)st->st_ino, (int)sizeof(size_t));
+    put_time(fp, st->st_mtime);
+    put_bytes(fp, (long_u)key, 2);
+    putc(map->mm_fileformat, fp);
+    putc(map->mm_noeol, fp);
+    put_bytes(fp, (long_u)map->mm_lines, (int)sizeof(size_t));
+    put_bytes(fp, (long_u)map->mm_len, (int)sizeof(size_t));
+    put_bytes(fp, (long_u)count, (int)sizeof(size_t));
+    put_bytes(fp, (long_u)mmap_index_hash(map->mm_addr, map->mm_len,
+			     map->mm_index, count), (int)sizeof(size_t));
+    for (i = 0; i < count; ++i)
+	put_bytes(fp, (long_u)map->mm_index[i], (int)sizeof(size_t));
+
+    error = ferror(fp);
+    if (fclose(fp) != 0 || error)
+	mch_remove(file_name);
+
+theend:
+    vim_free(file_name);
+}
+
+/*
+ * Read a size_t from "fp", MSB first.
+ */
+    static size_t
+mmap_index_get(fp)
+    FILE	*fp;
+{
+    size_t	n = 0;
+    int		i;
+
+    for (i = 0; i < (int)sizeof(size_t); ++i)
+	n = (n << 8) + getc(fp);
+    return n;
+}
+
+/*
+ * Compute a hash over the text of the lines mmap_index_read() checks: the
+ * start of the text, the start of the sampled lines in "index" and the end
+ * of the text.  "len" is the length of the text at "addr", "count" the
+ * number of entries in "index".
+ */
+    static size_t
+mmap_index_hash(addr, len, index, count)
+    char_u	*addr;
+    size_t	len;
+    size_t	*index;
+    size_t	count;
+{
+    size_t	hash = 0;
+    size_t	step = count / MI_SAMPLES + 1;
+    size_t	i;
+    size_t	off;
+    size_t	end;
+
+    for (i = 0; ; i = (i == 0 ? 1 : i + step))
+    {
+	if (i < count)
+	    off = index[i];
+	else
+	    off = len > MI_SAMPLE_LEN ? len - MI_SAMPLE_LEN : 0;
+	end = len - off > MI_SAMPLE_LEN ? off + MI_SAMPLE_LEN : len;
+	for ( ; off < end; ++off)
+	    hash = hash * 101 + addr[off];
+	if (i >= count)
+	    break;
+    }
+    return hash;
+}
+# endif
+#endif
+
 /*
  * Fill "*eap" to force the 'fileencoding', 'fileformat' and 'binary to be
  * equal to the buffer "buf".  Used for calling readfile().
@@ -3167,8 +3743,11 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
     char_u	    *wfname = NULL;	/* name of file to write to */
     char_u	    *s;
     char_u	    *ptr;
+    char_u	    *p;
     char_u	    c;
     int		    len;
+    int		    n;
+    long	    linelen;
     linenr_T	    lnum;
     long	    nchars;
     char_u	    *errmsg = NULL;
@@ -3553,7 +4132,14 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 		    (char_u *)"", 0);	/* show that we are busy */
     msg_scroll = FALSE;		    /* always overwrite the file message now */
 
-    buffer = alloc(BUFSIZE);
+    /* Writing many lines with a big buffer avoids a lot of system calls. */
+    bufsize = end - start >= WRITEBIG_LINES ? WRITEBUFSIZE : BUFSIZE;
+    buffer = alloc(bufsize);
+    if (buffer == NULL && bufsize > BUFSIZE)
+    {
+	bufsize = BUFSIZE;
+	buffer = alloc(bufsize);
+    }
     if (buffer == NULL)		    /* can't allocate big buffer, use small
 				     * one (to be able to write when out of
 				     * memory) */
@@ -3561,8 +4147,6 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 	buffer = smallbuf;
 	bufsize = SMBUFSIZE;
     }
-    else
-	bufsize = BUFSIZE;
 
     /*
      * Get information about original file (if there is one).
@@ -3640,6 +4224,28 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
     }
 #endif /* !UNIX */
 
+#ifdef FEAT_MMAP_LOAD
+    /*
+     * Writing the file that a buffer was mapped from may change the text
+     * while it is being used, load the text into the memfile first.
+     */
+    if (!newfile)
+    {
+	buf_T	*mbuf;
+
+	for (mbuf = firstbuf; mbuf != NULL; mbuf = mbuf->b_next)
+	    if (mbuf->b_ml.ml_map != NULL
+		    && mbuf->b_ml.ml_map->mm_dev == st_old.st_dev
+		    && mbuf->b_ml.ml_map->mm_ino == st_old.st_ino
+		    && ml_map_load(mbuf) == FAIL)
+	    {
+		errnum = (char_u *)"E881: ";
+		errmsg = (char_u *)_("is mapped and can't be loaded into memory");
+		goto fail;
+	    }
+    }
+#endif
+
     if (!device && !newfile)
     {
 	/*
@@ -4033,12 +4639,12 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 			 * copy the file.
 			 */
 			write_info.bw_fd = bfd;
-			write_info.bw_buf = copybuf;
+			write_info.bw_buf = buffer;
 #ifdef HAS_BW_FLAGS
 			write_info.bw_flags = FIO_NOCONVERT;
 #endif
-			while ((write_info.bw_len = read_eintr(fd, copybuf,
-								BUFSIZE)) > 0)
+			while ((write_info.bw_len = read_eintr(fd, buffer,
+							       bufsize)) > 0)
 			{
 			    if (buf_write_bytes(&write_info) == FAIL)
 			    {
@@ -4569,25 +5175,32 @@ restore_backup:
     len = 0;
     for (lnum = start; lnum <= end; ++lnum)
     {
-	/*
-	 * The next while loop is done once for each character written.
-	 * Keep it fast!
-	 */
-	ptr = ml_get_buf(buf, lnum, FALSE) - 1;
+	ptr = ml_get_buf(buf, lnum, FALSE);
+	linelen = (long)STRLEN(ptr);
 #ifdef FEAT_PERSISTENT_UNDO
 	if (write_undo_file)
-	    sha256_update(&sha_ctx, ptr + 1, (UINT32_T)(STRLEN(ptr + 1) + 1));
+	    sha256_update(&sha_ctx, ptr, (UINT32_T)(linelen + 1));
 #endif
-	while ((c = *++ptr) != NUL)
-	{
-	    if (c == NL)
-		*s = NUL;		/* replace newlines with NULs */
-	    else if (c == CAR && fileformat == EOL_MAC)
-		*s = NL;		/* Mac: replace CRs with NLs */
-	    else
-		*s = c;
-	    ++s;
-	    if (++len != bufsize)
+	/*
+	 * Copy the text of the line in pieces that fit in the buffer, then
+	 * replace newlines with NULs and for Mac CRs with NLs.  This is done
+	 * for every line written, keep it fast!
+	 */
+	while (linelen > 0)
+	{
+	    n = bufsize - len;
+	    if (n > linelen)
+		n = (int)linelen;
+	    mch_memmove(s, ptr, (size_t)n);
+	    for (p = s; (p = vim_memchr2(p, NL,
+				     fileformat == EOL_MAC ? CAR : NL,
+				     (size_t)(s + n - p))) != NULL; ++p)
+		*p = (*p == NL) ? NUL : NL;
+	    ptr += n;
+	    s += n;
+	    len += n;
+	    linelen -= n;
+	    if (len != bufsize)
 		continue;
 	    if (buf_write_bytes(&write_info) == FAIL)
 	    {
@@ -5395,10 +6008,21 @@ buf_write_bytes(ip)
 	{
 	    /*
 	     * Convert latin1 in the buffer to UTF-8 in the file.
+	     * ASCII characters are copied unchanged.
 	     */
 	    p = ip->bw_conv_buf;	/* translate to buffer */
 	    for (wlen = 0; wlen < len; ++wlen)
-		p += utf_char2bytes(buf[wlen], p);
+	    {
+		if (buf[wlen] < 0x80)
+		{
+		    n = (int)vim_ascii_len(buf + wlen, (size_t)(len - wlen));
+		    mch_memmove(p, buf + wlen, (size_t)n);
+		    p += n;
+		    wlen += n - 1;
+		}
+		else
+		    p += utf_char2bytes(buf[wlen], p);
+	    }
 	    buf = ip->bw_conv_buf;
 	    len = (int)(p - ip->bw_conv_buf);
 	}
@@ -5453,6 +6077,38 @@ buf_write_bytes(ip)
 			n = 0;
 		    }
 		}
+		else if (buf[wlen] < 0x80 && !(flags & FIO_UCS4))
+		{
+		    /* Fast path for a run of ASCII characters. */
+		    n = (int)vim_ascii_len(buf + wlen, (size_t)(len - wlen));
+		    if (!ip->bw_conv_error)
+			ip->bw_start_lnum += vim_memcnt(buf + wlen, NL,
+								   (size_t)n);
+		    if (flags & FIO_LATIN1)
+		    {
+			mch_memmove(p, buf + wlen, (size_t)n);
+			p += n;
+		    }
+		    else
+		    {
+			char_u	*s = buf + wlen;
+			char_u	*e = s + n;
+
+			if (flags & FIO_ENDIAN_L)
+			    for ( ; s < e; ++s)
+			    {
+				*p++ = *s;
+				*p++ = 0;
+			    }
+			else
+			    for ( ; s < e; ++s)
+			    {
+				*p++ = 0;
+				*p++ = *s;
+			    }
+		    }
+		    continue;
+		}
 		else
 		{
 		    n = utf_ptr2len_len(buf + wlen, len - wlen);
@@ -7155,6 +7811,12 @@ buf_reload(buf, orig_mode)
 	old_cursor = curwin->w_cursor;
 	old_topline = curwin->w_topline;
 
+#ifdef FEAT_MMAP_LOAD
+	/* The text of a mapped buffer is in the file that was changed, it
+	 * can't be saved. */
+	ml_map_discard(curbuf);
+#endif
+
 	if (p_ur < 0 || curbuf->b_ml.ml_line_count <= p_ur)
 	{
 	    /* Save all the text, so that the reload can be undone.
@@ -237,6 +237,7 @@ EXTERN int	debug_did_msg INIT(= FALSE);	/* did "debug mode" message */
 EXTERN int	debug_tick INIT(= 0);		/* breakpoint change count */
 # ifdef FEAT_PROFILE
 EXTERN int	do_profiling INIT(= PROF_NONE);	/* PROF_ values */
+EXTERN int	regtime_id INIT(= 0);	/* syntax group for ":regtime" */
 # endif
 
 /*
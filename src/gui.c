@@ -3344,6 +3344,10 @@ gui_init_which_components(oldval)
     static int	prev_footer = -1;
     int		using_footer = FALSE;
 #endif
+#ifdef FEAT_GUI_QT
+    static int	prev_opengl = -1;
+    int		using_opengl = FALSE;
+#endif
 #if defined(FEAT_MENU) && !defined(WIN16)
     static int	prev_tearoff = -1;
     int		using_tearoff = FALSE;
@@ -3419,6 +3423,11 @@ gui_init_which_components(oldval)
 	    case GO_FOOTER:
 		using_footer = TRUE;
 		break;
+#endif
+#ifdef FEAT_GUI_QT
+	    case GO_OPENGL:
+		using_opengl = TRUE;
+		break;
 #endif
 	    case GO_TEAROFF:
 #if defined(FEAT_MENU) && !defined(WIN16)
@@ -3528,6 +3537,13 @@ gui_init_which_components(oldval)
 		fix_size = TRUE;
 	}
 #endif
+#ifdef FEAT_GUI_QT
+	if (using_opengl != prev_opengl)
+	{
+	    gui_mch_enable_opengl(using_opengl);
+	    prev_opengl = using_opengl;
+	}
+#endif
 #if defined(FEAT_MENU) && !defined(WIN16) && !(defined(WIN3264) && !defined(FEAT_TEAROFF))
 	if (using_tearoff != prev_tearoff)
 	{
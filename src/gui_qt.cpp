@@ -201,6 +201,8 @@ gui_mch_wait_for_chars(long wtime)
 		return OK;
 	}
 
+	// Vim is idle, show everything right away
+	vimshell->flushDamage();
 	return vimshell->processEvents(wtime, true);
 }
 
@@ -213,6 +215,7 @@ gui_mch_wait_for_chars(long wtime)
 void
 gui_mch_update()
 {
+	vimshell->requestFrame();
 	vimshell->processEvents();
 }
 
@@ -223,6 +226,7 @@ gui_mch_update()
 void
 gui_mch_flush()
 {
+	vimshell->requestFrame();
 	vimshell->processEvents(0, true);
 }
 
@@ -342,6 +346,8 @@ gui_mch_init_font(char_u *font_name, int do_fontset)
 	gui.norm_font = qf;
 	update_char_metrics(metric);
 	vimshell->setCharWidth(gui.char_width);
+	vimshell->setFont(*qf);
+	vimshell->clearFontVariants();
 
 	return OK;
 }
@@ -422,30 +428,6 @@ gui_mch_clear_block(int row1, int col1, int row2, int col2)
 	vimshell->queuePaintOp(op);
 }
 
-/**
- * Clear the shell margin
- *
- * The shell is a grid whose size is a multiple of its column/row size.
- * Sometimes an extra margin is in place, this paints that margin.
- */
-static void
-clear_shell_border()
-{
-	QPoint tl, br;
-
-	tl.setX(0);
-	tl.setY( vimshell->height() - (vimshell->height() % gui.char_height ));
-	
-	br.setX(vimshell->width());
-	br.setY(vimshell->height());
-
-	QVimShell::PaintOperation op;
-	op.type = QVimShell::FILLRECT;
-	op.color = VimWrapper::fromColor(gui.back_pixel);
-	op.rect = QRect(tl, br);
-	vimshell->queuePaintOp(op);
-}
-
 /**
  * Insert the given number of lines before the given row, scrolling down any
  * following text within the scroll region.
@@ -462,8 +444,6 @@ gui_mch_insert_lines(int row, int num_lines)
 	op1.pos = QPoint(0, num_lines*gui.char_height);
 	op1.color = VimWrapper::fromColor(gui.back_pixel);
 	vimshell->queuePaintOp(op1);
-
-	clear_shell_border();
 }
 
 /*
@@ -781,7 +761,7 @@ gui_mch_set_font(GuiFont font)
 	if (font == NULL) {
 		return;
 	}
-	vimshell->setFont(*font);
+	vimshell->setTextFont(*font);
 }
 
 
@@ -794,6 +774,10 @@ gui_mch_exit(int rc)
 	if ( !QApplication::instance() )
 		return;
 
+	if ( getenv("QVIM_PAINT_STATS") ) {
+		vimshell->dumpPaintStats();
+	}
+
 	QSettings settings("Vim", "qVim");
 	settings.beginGroup("mainwindow");
 	settings.setValue("state", window->saveState());
@@ -914,6 +898,19 @@ gui_mch_open()
 	return OK;
 }
 
+/**
+ * Enable/Disable OpenGL drawing of the text area
+ */
+void
+gui_mch_enable_opengl(int enable)
+{
+	if ( !vimshell->setOpenGL(enable != 0) && p_verbose > 0 ) {
+		verbose_enter();
+		MSG(_("OpenGL 2.0 is not available, using raster painting"));
+		verbose_leave();
+	}
+}
+
 /**
  * Draw a cursor without focus.
  */
@@ -988,34 +985,37 @@ gui_mch_draw_string(
 	QString str = VimWrapper::convertFrom(s, len);
 	
 	// Font
-	QFont f = vimshell->font();
-	f.setBold( flags & DRAW_BOLD);
-	f.setUnderline( flags & DRAW_UNDERL);
-	f.setItalic( flags & DRAW_ITALIC);
-
-	QFontMetrics fm(f);
+	int style = 0;
+	if ( flags & DRAW_BOLD ) {
+		style |= QVimShell::StyleBold;
+	}
+	if ( flags & DRAW_ITALIC ) {
+		style |= QVimShell::StyleItalic;
+	}
+	// No underline if undercurl is in place
+	if ( (flags & DRAW_UNDERL) && !(flags & DRAW_UNDERC) ) {
+		style |= QVimShell::StyleUnderline;
+	}
+	int variant = vimshell->textFontVariant(style);
 
 	int cellwidth = VimWrapper::stringCellWidth(str);
+	if ( cellwidth == 0 ) {
+		// A lone composing char, drawn over the previous cell
+		cellwidth = 1;
+	}
 	QPoint pos = VimWrapper::mapText(row, col);
 	QRect rect( pos.x(), pos.y(), gui.char_width*cellwidth, gui.char_height);
 
-	if (flags & DRAW_TRANSP) {
-		// Do we need to do anything?
-	} else {
-		// Fill in the background
-		QVimShell::PaintOperation op;
-		op.type = QVimShell::FILLRECT;
-		op.rect = rect;
-		op.color = backgroundColor;
-		vimshell->queuePaintOp(op);
-	}
-
-	// Remove upper linespace from rect
-	QRect rect_text( pos.x(), pos.y() + p_linespace/2, gui.char_width*cellwidth, gui.char_height);
+	// The background is filled in as part of the same operation,
+	// unless the string is transparent
 	QVimShell::PaintOperation op;
 	op.type = QVimShell::DRAWSTRING;
-	op.font = f;
-	op.rect = rect_text;
+	if ( !(flags & DRAW_TRANSP) ) {
+		op.bgcolor = backgroundColor;
+	}
+	op.font = vimshell->fontVariant(variant).font;
+	op.fontVariant = variant;
+	op.rect = rect;
 	op.str = str;
 	op.color = foregroundColor;
 	op.undercurl = flags & DRAW_UNDERC;
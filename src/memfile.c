@@ -67,7 +67,28 @@ extern int dos2;			/* this is in os_amiga.c */
 
 #define MEMFILE_PAGE_SIZE 4096		/* default page size */
 
+/*
+ * When writev() is available mf_sync() writes dirty blocks that follow each
+ * other in the file with one system call.  MF_RUN_MAX is the maximum number
+ * of blocks written at once.
+ */
+#if defined(HAVE_WRITEV) && defined(HAVE_SYS_UIO_H) && defined(UNIX)
+# define MF_USE_WRITEV
+# if defined(IOV_MAX) && IOV_MAX < 64
+#  define MF_RUN_MAX IOV_MAX
+# else
+#  define MF_RUN_MAX 64
+# endif
+#endif
+
 static long_u	total_mem_used = 0;	/* total memory used for memfiles */
+static long_u	mf_use_clock = 0;	/* incremented for every block inserted
+					   in a used list */
+
+/* Totals of the cache statistics, including closed memfiles. */
+static long	total_hits = 0;
+static long	total_misses = 0;
+static long	total_evictions = 0;
 
 static void mf_ins_hash __ARGS((memfile_T *, bhdr_T *));
 static void mf_rem_hash __ARGS((memfile_T *, bhdr_T *));
@@ -75,6 +96,8 @@ static bhdr_T *mf_find_hash __ARGS((memfile_T *, blocknr_T));
 static void mf_ins_used __ARGS((memfile_T *, bhdr_T *));
 static void mf_rem_used __ARGS((memfile_T *, bhdr_T *));
 static bhdr_T *mf_release __ARGS((memfile_T *, int));
+static memfile_T *mf_lru_memfile __ARGS((memfile_T *mfp));
+static bhdr_T *mf_find_victim __ARGS((memfile_T *mfp));
 static bhdr_T *mf_alloc_bhdr __ARGS((memfile_T *, int));
 static void mf_free_bhdr __ARGS((bhdr_T *));
 static void mf_ins_free __ARGS((memfile_T *, bhdr_T *));
@@ -83,6 +106,15 @@ static int  mf_read __ARGS((memfile_T *, bhdr_T *));
 static int  mf_write __ARGS((memfile_T *, bhdr_T *));
 static int  mf_write_block __ARGS((memfile_T *mfp, bhdr_T *hp, off_t offset, unsigned size));
 static int  mf_trans_add __ARGS((memfile_T *, bhdr_T *));
+#ifdef MF_USE_WRITEV
+static int  mf_sync_sorted __ARGS((memfile_T *mfp, int flags, int *donep));
+static int  mf_write_run __ARGS((memfile_T *mfp, bhdr_T **hps, int count));
+static int
+# ifdef __BORLANDC__
+_RTLENTRYF
+# endif
+mf_bnum_compare __ARGS((const void *s1, const void *s2));
+#endif
 static void mf_do_open __ARGS((memfile_T *, char_u *, int));
 static void mf_hash_init __ARGS((mf_hashtab_T *));
 static void mf_hash_free __ARGS((mf_hashtab_T *));
@@ -158,6 +190,9 @@ mf_open(fname, flags)
     mfp->mf_used_last = NULL;
     mfp->mf_dirty = FALSE;
     mfp->mf_used_count = 0;
+    mfp->mf_hits = 0;
+    mfp->mf_misses = 0;
+    mfp->mf_evictions = 0;
     mf_hash_init(&mfp->mf_hash);
     mf_hash_init(&mfp->mf_trans);
     mfp->mf_page_size = MEMFILE_PAGE_SIZE;
@@ -462,11 +497,16 @@ mf_get(mfp, nr, page_count)
 	    mf_free_bhdr(hp);
 	    return NULL;
 	}
+	++mfp->mf_misses;
+	++total_misses;
     }
     else
     {
 	mf_rem_used(mfp, hp);	/* remove from list, insert in front below */
 	mf_rem_hash(mfp, hp);
+	hp->bh_flags |= BH_REF;
+	++mfp->mf_hits;
+	++total_hits;
     }
 
     hp->bh_flags |= BH_LOCKED;
@@ -559,6 +599,7 @@ mf_sync(mfp, flags)
 {
     int		status;
     bhdr_T	*hp;
+    int		done;
 #if defined(SYNC_DUP_CLOSE) && !defined(MSDOS)
     int		fd;
 #endif
@@ -580,38 +621,47 @@ mf_sync(mfp, flags)
      * Then we only try to write blocks within the existing file. If that also
      * fails then we give up.
      */
-    status = OK;
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
-		&& (hp->bh_flags & BH_DIRTY)
-		&& (status == OK || (hp->bh_bnum >= 0
-		    && hp->bh_bnum < mfp->mf_infile_count)))
-	{
-	    if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
-		continue;
-	    if (mf_write(mfp, hp) == FAIL)
-	    {
-		if (status == FAIL)	/* double error: quit syncing */
-		    break;
-		status = FAIL;
-	    }
-	    if (flags & MFS_STOP)
+#ifdef MF_USE_WRITEV
+    /* Writing the blocks in file order, several at a time, is a lot faster
+     * when many blocks are dirty. */
+    if ((flags & MFS_ZERO)
+	    || (status = mf_sync_sorted(mfp, flags, &done)) == MAYBE)
+#endif
+    {
+	status = OK;
+	for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	    if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+		    && (hp->bh_flags & BH_DIRTY)
+		    && (status == OK || (hp->bh_bnum >= 0
+			&& hp->bh_bnum < mfp->mf_infile_count)))
 	    {
-		/* Stop when char available now. */
-		if (ui_char_avail())
+		if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
+		    continue;
+		if (mf_write(mfp, hp) == FAIL)
+		{
+		    if (status == FAIL)	/* double error: quit syncing */
+			break;
+		    status = FAIL;
+		}
+		if (flags & MFS_STOP)
+		{
+		    /* Stop when char available now. */
+		    if (ui_char_avail())
+			break;
+		}
+		else
+		    ui_breakcheck();
+		if (got_int)
 		    break;
 	    }
-	    else
-		ui_breakcheck();
-	    if (got_int)
-		break;
-	}
+	done = (hp == NULL);
+    }
 
     /*
      * If the whole list is flushed, the memfile is not dirty anymore.
      * In case of an error this flag is also set, to avoid trying all the time.
      */
-    if (hp == NULL || status == FAIL)
+    if (done || status == FAIL)
 	mfp->mf_dirty = FALSE;
 
     if ((flags & MFS_FLUSH) && *p_sws != NUL)
@@ -780,6 +830,7 @@ mf_ins_used(mfp, hp)
 	mfp->mf_used_last = hp;
     else
 	hp->bh_next->bh_prev = hp;
+    hp->bh_used = ++mf_use_clock;
     mfp->mf_used_count += hp->bh_page_count;
     total_mem_used += hp->bh_page_count * mfp->mf_page_size;
 }
@@ -807,9 +858,15 @@ mf_rem_used(mfp, hp)
 /*
  * Release the least recently used block from the used list if the number
  * of used memory blocks gets to big.
+ * When only the total memory used is over 'maxmemtot' the block is taken
+ * from the memfile that has the least recently used block, which may be for
+ * another buffer.  That avoids that the current buffer keeps re-reading its
+ * blocks from the swap file while other buffers are not used at all.
  *
  * Return the block header to the caller, including the memory block, so
  * it can be re-used. Make sure the page_count is right.
+ * Returns NULL when no block was released or it was released for another
+ * memfile.
  */
     static bhdr_T *
 mf_release(mfp, page_count)
@@ -818,7 +875,9 @@ mf_release(mfp, page_count)
 {
     bhdr_T	*hp;
     int		need_release;
+    int		over_total;
     buf_T	*buf;
+    memfile_T	*vmfp = mfp;	    /* memfile to release a block from */
 
     /* don't release while in mf_close_file() */
     if (mf_dont_release)
@@ -828,14 +887,14 @@ mf_release(mfp, page_count)
      * Need to release a block if the number of blocks for this memfile is
      * higher than the maximum or total memory used is over 'maxmemtot'
      */
-    need_release = ((mfp->mf_used_count >= mfp->mf_used_count_max)
-				  || (total_mem_used >> 10) >= (long_u)p_mmt);
+    need_release = (mfp->mf_used_count >= mfp->mf_used_count_max);
+    over_total = ((total_mem_used >> 10) >= (long_u)p_mmt);
 
     /*
      * Try to create a swap file if the amount of memory used is getting too
      * high.
      */
-    if (mfp->mf_fd < 0 && need_release && p_uc)
+    if (mfp->mf_fd < 0 && (need_release || over_total) && p_uc)
     {
 	/* find for which buffer this memfile is */
 	for (buf = firstbuf; buf != NULL; buf = buf->b_next)
@@ -845,20 +904,20 @@ mf_release(mfp, page_count)
 	    ml_open_file(buf);
     }
 
+    if (!need_release)
+    {
+	if (!over_total)
+	    return NULL;
+	vmfp = mf_lru_memfile(mfp);
+    }
+
     /*
-     * don't release a block if
-     *	there is no file for this memfile
-     * or
-     *	the number of blocks for this memfile is lower than the maximum
-     *	  and
-     *	total memory used is not up to 'maxmemtot'
+     * don't release a block if there is no file for the memfile
      */
-    if (mfp->mf_fd < 0 || !need_release)
+    if (vmfp == NULL || vmfp->mf_fd < 0)
 	return NULL;
 
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (!(hp->bh_flags & BH_LOCKED))
-	    break;
+    hp = mf_find_victim(vmfp);
     if (hp == NULL)	/* not a single one that can be released */
 	return NULL;
 
@@ -866,11 +925,20 @@ mf_release(mfp, page_count)
      * If the block is dirty, write it.
      * If the write fails we don't free it.
      */
-    if ((hp->bh_flags & BH_DIRTY) && mf_write(mfp, hp) == FAIL)
+    if ((hp->bh_flags & BH_DIRTY) && mf_write(vmfp, hp) == FAIL)
 	return NULL;
 
-    mf_rem_used(mfp, hp);
-    mf_rem_hash(mfp, hp);
+    mf_rem_used(vmfp, hp);
+    mf_rem_hash(vmfp, hp);
+    ++vmfp->mf_evictions;
+    ++total_evictions;
+
+    if (vmfp != mfp)
+    {
+	/* The caller allocates a block of its own page size. */
+	mf_free_bhdr(hp);
+	return NULL;
+    }
 
     /*
      * If a bhdr_T is returned, make sure that the page_count of bh_data is
@@ -889,6 +957,81 @@ mf_release(mfp, page_count)
     return hp;
 }
 
+/*
+ * Find the memfile with a swap file that has the least recently used block
+ * which is not locked.  Prefers "mfp" when it has a block that can be
+ * released and no other memfile has an older one.
+ * Returns NULL if there is none.
+ */
+    static memfile_T *
+mf_lru_memfile(mfp)
+    memfile_T	*mfp;
+{
+    buf_T	*buf;
+    memfile_T	*best = NULL;
+    memfile_T	*m;
+    bhdr_T	*hp;
+    long_u	oldest = 0;
+
+    for (buf = firstbuf; ; buf = buf->b_next)
+    {
+	/* "mfp" may not be in the buffer list, e.g. when recovering */
+	if (buf == NULL)
+	    m = mfp;
+	else if ((m = buf->b_ml.ml_mfp) == mfp || m == NULL)
+	    continue;
+	if (m->mf_fd >= 0)
+	{
+	    for (hp = m->mf_used_last; hp != NULL; hp = hp->bh_prev)
+		if (!(hp->bh_flags & BH_LOCKED))
+		    break;
+	    if (hp != NULL && (best == NULL || hp->bh_used <= oldest))
+	    {
+		best = m;
+		oldest = hp->bh_used;
+	    }
+	}
+	if (buf == NULL)
+	    break;
+    }
+    return best;
+}
+
+/*
+ * Find a block in the used list of "mfp" that can be released: the last one
+ * that is not locked.  A block that was found in the cache since it was put
+ * in front of the list (BH_REF) is moved to the front once more, that keeps
+ * often used blocks, such as pointer blocks, in memory when going through a
+ * big file.
+ * Returns NULL if there is none.
+ */
+    static bhdr_T *
+mf_find_victim(mfp)
+    memfile_T	*mfp;
+{
+    bhdr_T	*hp;
+    bhdr_T	*prev;
+    bhdr_T	*first_moved = NULL;
+
+    for (hp = mfp->mf_used_last; hp != NULL && hp != first_moved; hp = prev)
+    {
+	prev = hp->bh_prev;
+	if (hp->bh_flags & BH_LOCKED)
+	    continue;
+	if (!(hp->bh_flags & BH_REF))
+	    return hp;
+	/* second chance */
+	hp->bh_flags &= ~BH_REF;
+	mf_rem_used(mfp, hp);
+	mf_ins_used(mfp, hp);
+	if (first_moved == NULL)
+	    first_moved = hp;
+    }
+
+    /* All unlocked blocks were moved, use the oldest one. */
+    return first_moved;
+}
+
 /*
  * release as many blocks as possible
  * Used in case of out of memory
@@ -924,6 +1067,8 @@ mf_release_all()
 			mf_rem_used(mfp, hp);
 			mf_rem_hash(mfp, hp);
 			mf_free_bhdr(hp);
+			++mfp->mf_evictions;
+			++total_evictions;
 			hp = mfp->mf_used_last;	/* re-start, list was changed */
 			retval = TRUE;
 		    }
@@ -936,6 +1081,42 @@ mf_release_all()
     return retval;
 }
 
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Add the block cache statistics of "mfp" to dictionary "d".  When "mfp" is
+ * NULL add the totals for all memfiles, including ones that were closed.
+ */
+    void
+mf_stats(mfp, d)
+    memfile_T	*mfp;
+    dict_T	*d;
+{
+    buf_T	*buf;
+    long	blocks = 0;
+
+    if (mfp == NULL)
+    {
+	for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	    if (buf->b_ml.ml_mfp != NULL)
+		blocks += buf->b_ml.ml_mfp->mf_used_count;
+	dict_add_nr_str(d, "hits", total_hits, NULL);
+	dict_add_nr_str(d, "misses", total_misses, NULL);
+	dict_add_nr_str(d, "evictions", total_evictions, NULL);
+	dict_add_nr_str(d, "pages", blocks, NULL);
+	dict_add_nr_str(d, "memused", (long)(total_mem_used >> 10), NULL);
+    }
+    else
+    {
+	dict_add_nr_str(d, "hits", mfp->mf_hits, NULL);
+	dict_add_nr_str(d, "misses", mfp->mf_misses, NULL);
+	dict_add_nr_str(d, "evictions", mfp->mf_evictions, NULL);
+	dict_add_nr_str(d, "pages", (long)mfp->mf_used_count, NULL);
+	dict_add_nr_str(d, "memused", (long)(((long_u)mfp->mf_used_count
+					       * mfp->mf_page_size) >> 10), NULL);
+    }
+}
+#endif
+
 /*
  * Allocate a block header and a block of memory for it
  */
@@ -1152,6 +1333,200 @@ mf_write_block(mfp, hp, offset, size)
     return result;
 }
 
+#ifdef MF_USE_WRITEV
+/*
+ * Sync the dirty blocks of "mfp" ordered on block number, so that blocks
+ * that follow each other in the file are written with one writev() call.
+ * "flags" is used like in mf_sync().  Sets "*donep" to TRUE when all dirty
+ * blocks were written.
+ * Returns MAYBE when this can't be done, mf_sync() then writes the blocks one
+ * by one.  Otherwise returns FAIL or OK.
+ */
+    static int
+mf_sync_sorted(mfp, flags, donep)
+    memfile_T	*mfp;
+    int		flags;
+    int		*donep;
+{
+    bhdr_T	**list;
+    bhdr_T	*hp;
+    int		count = 0;
+    int		i;
+    int		n;
+    int		status = OK;
+
+# ifdef FEAT_CRYPT
+    /* Encrypted blocks are written one by one, each needs its own buffer. */
+    if (mfp->mf_buffer != NULL && *mfp->mf_buffer->b_p_key != NUL)
+	return MAYBE;
+# endif
+
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						   && (hp->bh_flags & BH_DIRTY))
+	    ++count;
+    if (count < 2)
+	return MAYBE;
+    list = (bhdr_T **)alloc((unsigned)(count * sizeof(bhdr_T *)));
+    if (list == NULL)
+	return MAYBE;
+
+    /* Assign file block numbers from last to first used, as mf_write() would
+     * do, then sort on block number. */
+    count = 0;
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						   && (hp->bh_flags & BH_DIRTY))
+	{
+	    if (hp->bh_bnum < 0 && mf_trans_add(mfp, hp) == FAIL)
+	    {
+		status = FAIL;
+		continue;
+	    }
+	    list[count++] = hp;
+	}
+    qsort((void *)list, (size_t)count, sizeof(bhdr_T *), mf_bnum_compare);
+
+    /*
+     * If a write fails, it is very likely caused by a full filesystem.  Then
+     * we only try to write blocks within the existing file.  If that also
+     * fails then we give up.
+     */
+    for (i = 0; i < count; i += n)
+    {
+	hp = list[i];
+	n = 1;
+	/* Writing a block beyond the end of the file may also write blocks in
+	 * between, these are no longer dirty then. */
+	if (!(hp->bh_flags & BH_DIRTY) || (status == FAIL
+				     && hp->bh_bnum >= mfp->mf_infile_count))
+	    continue;
+
+	/* Find the dirty blocks directly following this one, when it doesn't
+	 * leave a gap in the file. */
+	if (hp->bh_bnum <= mfp->mf_infile_count)
+	    while (i + n < count && n < MF_RUN_MAX
+		    && (list[i + n]->bh_flags & BH_DIRTY)
+		    && (status == OK
+			   || list[i + n]->bh_bnum < mfp->mf_infile_count)
+		    && list[i + n]->bh_bnum == list[i + n - 1]->bh_bnum
+					      + list[i + n - 1]->bh_page_count)
+		++n;
+
+	if ((n == 1 ? mf_write(mfp, hp) : mf_write_run(mfp, list + i, n))
+									== FAIL)
+	{
+	    if (status == FAIL)		/* double error: quit syncing */
+		break;
+	    status = FAIL;
+	}
+	if (flags & MFS_STOP)
+	{
+	    /* Stop when char available now. */
+	    if (ui_char_avail())
+		break;
+	}
+	else
+	    ui_breakcheck();
+	if (got_int)
+	    break;
+    }
+    *donep = (i >= count);
+
+    vim_free(list);
+    return status;
+}
+
+/*
+ * Write the "count" blocks in "hps" with one writev() call.  The blocks must
+ * follow each other in the file and the first one must not be beyond the end
+ * of the file.
+ * Return FAIL for failure, OK otherwise
+ */
+    static int
+mf_write_run(mfp, hps, count)
+    memfile_T	*mfp;
+    bhdr_T	**hps;
+    int		count;
+{
+    struct iovec    iov[MF_RUN_MAX];
+    off_t	    offset;
+    long	    total = 0;
+    long	    done = 0;
+    long	    len;
+    int		    i;
+    int		    first = 0;
+    bhdr_T	    *last = hps[count - 1];
+
+    offset = (off_t)mfp->mf_page_size * hps[0]->bh_bnum;
+    if (lseek(mfp->mf_fd, offset, SEEK_SET) != offset)
+    {
+	PERROR(_("E296: Seek error in swap file write"));
+	return FAIL;
+    }
+    for (i = 0; i < count; ++i)
+    {
+	iov[i].iov_base = (void *)hps[i]->bh_data;
+	iov[i].iov_len = mfp->mf_page_size * hps[i]->bh_page_count;
+	total += (long)iov[i].iov_len;
+    }
+
+    /* Repeat the writev() so long it didn't fail, other than being
+     * interrupted by a signal.  After a partial write continue with what
+     * wasn't written yet. */
+    while (done < total)
+    {
+	len = (long)writev(mfp->mf_fd, iov + first, count - first);
+	if (len < 0)
+	{
+	    if (errno != EINTR)
+		break;
+	    continue;
+	}
+	done += len;
+	while (first < count && len >= (long)iov[first].iov_len)
+	    len -= (long)iov[first++].iov_len;
+	if (first < count)
+	{
+	    iov[first].iov_base = (char *)iov[first].iov_base + len;
+	    iov[first].iov_len -= len;
+	}
+    }
+    if (done < total)
+    {
+	/* Avoid repeating the error message, like mf_write() does. */
+	if (!did_swapwrite_msg)
+	    EMSG(_("E297: Write error in swap file"));
+	did_swapwrite_msg = TRUE;
+	return FAIL;
+    }
+    did_swapwrite_msg = FALSE;
+
+    for (i = 0; i < count; ++i)
+	hps[i]->bh_flags &= ~BH_DIRTY;
+    if (last->bh_bnum + (blocknr_T)last->bh_page_count > mfp->mf_infile_count)
+	mfp->mf_infile_count = last->bh_bnum + last->bh_page_count;
+    return OK;
+}
+
+/*
+ * Compare function for qsort() to sort block headers on block number.
+ */
+    static int
+# ifdef __BORLANDC__
+_RTLENTRYF
+# endif
+mf_bnum_compare(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    blocknr_T	n1 = (*(bhdr_T **)s1)->bh_bnum;
+    blocknr_T	n2 = (*(bhdr_T **)s2)->bh_bnum;
+
+    return n1 == n2 ? 0 : n1 > n2 ? 1 : -1;
+}
+#endif
+
 /*
  * Make block number for *hp positive and add it to the translation list
  *
@@ -200,6 +200,8 @@ struct block0
 #define B0_HAS_FENC	8
 
 #define STACK_INCR	5	/* nr of entries added to ml_stack at a time */
+#define ML_INDEX_MIN	100	/* searches from the root before building
+				   ml_index */
 
 /*
  * The line number where the first mark may be is remembered.
@@ -244,6 +246,10 @@ static void ml_flush_line __ARGS((buf_T *));
 static bhdr_T *ml_new_data __ARGS((memfile_T *, int, int));
 static bhdr_T *ml_new_ptr __ARGS((memfile_T *));
 static bhdr_T *ml_find_line __ARGS((buf_T *, linenr_T, int));
+static void ml_index_build __ARGS((buf_T *));
+static int ml_index_add __ARGS((buf_T *, blocknr_T, linenr_T, int));
+static int ml_index_lookup __ARGS((buf_T *, linenr_T));
+static bhdr_T *ml_index_find __ARGS((buf_T *, linenr_T));
 static int ml_add_stack __ARGS((buf_T *));
 static void ml_lineadd __ARGS((buf_T *, int));
 static int b0_magic_wrong __ARGS((ZERO_BL *));
@@ -260,6 +266,18 @@ static void ml_crypt_prepare __ARGS((memfile_T *mfp, off_t offset, int reading))
 #endif
 #ifdef FEAT_BYTEOFF
 static void ml_updatechunk __ARGS((buf_T *buf, long line, long len, int updtype));
+static int ml_chunk_build __ARGS((buf_T *buf));
+static void ml_chunk_add __ARGS((buf_T *buf, int ix, int lines, long size));
+static int ml_chunk_find __ARGS((buf_T *buf, linenr_T lnum, long offset, int ffdos, linenr_T *curlinep, long *sizep));
+#endif
+#ifdef FEAT_MMAP_LOAD
+static size_t ml_map_offset __ARGS((mlmap_T *map, linenr_T lnum));
+static long ml_map_boff __ARGS((mlmap_T *map, linenr_T lnum, int ffdos));
+static char_u *ml_map_get __ARGS((mlmap_T *map, linenr_T lnum));
+static linenr_T ml_map_lnum __ARGS((mlmap_T *map, size_t off));
+static char_u *ml_map_search __ARGS((char_u *p, size_t size, char_u *text, int len));
+static linenr_T ml_map_find_text __ARGS((mlmap_T *map, linenr_T lnum, int dir, linenr_T last, char_u *text, int len));
+static long ml_map_find_offset __ARGS((buf_T *buf, linenr_T lnum, long *offp));
 #endif
 
 /*
@@ -285,8 +303,22 @@ ml_open(buf)
     buf->b_ml.ml_stack_top = 0;	/* nothing in the stack */
     buf->b_ml.ml_locked = NULL;	/* no cached block */
     buf->b_ml.ml_line_lnum = 0;	/* no cached line */
+    buf->b_ml.ml_index = NULL;	/* no index of data blocks */
+    buf->b_ml.ml_index_len = 0;
+    buf->b_ml.ml_index_size = 0;
+    buf->b_ml.ml_find_locked = 0;
+    buf->b_ml.ml_find_stack = 0;
+    buf->b_ml.ml_find_index = 0;
+    buf->b_ml.ml_find_root = 0;
+    buf->b_ml.ml_root_count = 0;
 #ifdef FEAT_BYTEOFF
     buf->b_ml.ml_chunksize = NULL;
+    buf->b_ml.ml_chunktree = NULL;
+    buf->b_ml.ml_chunktree_size = 0;
+    buf->b_ml.ml_chunktree_ok = FALSE;
+#endif
+#ifdef FEAT_MMAP_LOAD
+    buf->b_ml.ml_map = NULL;
 #endif
 
     /*
@@ -815,9 +847,19 @@ ml_close(buf, del_file)
     if (buf->b_ml.ml_line_lnum != 0 && (buf->b_ml.ml_flags & ML_LINE_DIRTY))
 	vim_free(buf->b_ml.ml_line_ptr);
     vim_free(buf->b_ml.ml_stack);
+    vim_free(buf->b_ml.ml_index);
+    buf->b_ml.ml_index = NULL;
 #ifdef FEAT_BYTEOFF
     vim_free(buf->b_ml.ml_chunksize);
     buf->b_ml.ml_chunksize = NULL;
+    vim_free(buf->b_ml.ml_chunktree);
+    buf->b_ml.ml_chunktree = NULL;
+    buf->b_ml.ml_chunktree_size = 0;
+    buf->b_ml.ml_chunktree_ok = FALSE;
+#endif
+#ifdef FEAT_MMAP_LOAD
+    ml_map_free(buf->b_ml.ml_map);
+    buf->b_ml.ml_map = NULL;
 #endif
     buf->b_ml.ml_mfp = NULL;
 
@@ -1166,6 +1208,8 @@ ml_recover()
     buf->b_ml.ml_stack_top = 0;		/* nothing in the stack */
     buf->b_ml.ml_line_lnum = 0;		/* no cached line */
     buf->b_ml.ml_locked = NULL;		/* no locked block */
+    buf->b_ml.ml_index = NULL;		/* no index of data blocks */
+    buf->b_ml.ml_index_len = 0;
     buf->b_ml.ml_flags = 0;
 #ifdef FEAT_CRYPT
     buf->b_p_key = empty_option;
@@ -1689,6 +1733,7 @@ theend:
 	free_string_option(buf->b_p_cm);
 #endif
 	vim_free(buf->b_ml.ml_stack);
+	vim_free(buf->b_ml.ml_index);
 	vim_free(buf);
     }
     if (serious_error && called_from_main)
@@ -2444,6 +2489,32 @@ errorret:
     if (buf->b_ml.ml_mfp == NULL)	/* there are no lines */
 	return (char_u *)"";
 
+#ifdef FEAT_MMAP_LOAD
+    /*
+     * Lines of a mapped file are copied from the mapping.  When a line is
+     * going to change all lines are loaded into the memfile first.
+     */
+    if (buf->b_ml.ml_map != NULL)
+    {
+	if (will_change)
+	{
+	    if (ml_map_load(buf) == FAIL)
+		goto errorret;
+	}
+	else
+	{
+	    if (buf->b_ml.ml_line_lnum != lnum)
+	    {
+		if ((ptr = ml_map_get(buf->b_ml.ml_map, lnum)) == NULL)
+		    goto errorret;
+		buf->b_ml.ml_line_ptr = ptr;
+		buf->b_ml.ml_line_lnum = lnum;
+	    }
+	    return buf->b_ml.ml_line_ptr;
+	}
+    }
+#endif
+
     /*
      * See if it is the same line as requested last time.
      * Otherwise may need to flush last used line.
@@ -2495,6 +2566,58 @@ ml_line_alloced()
     return (curbuf->b_ml.ml_flags & ML_LINE_DIRTY);
 }
 
+/*
+ * Find the first line from "lnum" in direction "dir" up to and including line
+ * "last" that contains "text" of "len" bytes.  Goes through the lines of each
+ * data block without getting every line with ml_get_buf(), which is much
+ * faster when only a few lines contain "text".
+ * Returns the line number, "last" + "dir" when no line contains "text".  May
+ * return "lnum" when not sure.
+ */
+    linenr_T
+ml_find_text(buf, lnum, dir, last, text, len)
+    buf_T	*buf;
+    linenr_T	lnum;
+    int		dir;
+    linenr_T	last;
+    char_u	*text;
+    int		len;
+{
+    bhdr_T	*hp;
+    DATA_BL	*dp;
+    int		idx;
+
+    if (buf->b_ml.ml_mfp == NULL || lnum < 1
+				       || lnum > buf->b_ml.ml_line_count)
+	return lnum;
+#ifdef FEAT_MMAP_LOAD
+    if (buf->b_ml.ml_map != NULL)
+	return ml_map_find_text(buf->b_ml.ml_map, lnum, dir, last, text, len);
+#endif
+
+    /* The block may not have the changed text of the cached line. */
+    ml_flush_line(buf);
+
+    while (dir == FORWARD ? lnum <= last : lnum >= last)
+    {
+	if ((hp = ml_find_line(buf, lnum, ML_FIND)) == NULL)
+	    return lnum;	/* let ml_get_buf() give the error */
+	dp = (DATA_BL *)(hp->bh_data);
+	do
+	{
+	    idx = lnum - buf->b_ml.ml_locked_low;
+	    if (strstr((char *)dp + (dp->db_index[idx] & DB_INDEX_MASK),
+						      (char *)text) != NULL)
+		return lnum;
+	    if (lnum == last)
+		return last + dir;
+	    lnum += dir;
+	} while (lnum >= buf->b_ml.ml_locked_low
+					   && lnum <= buf->b_ml.ml_locked_high);
+    }
+    return last + dir;
+}
+
 /*
  * Append a line after lnum (may be 0 to insert a line in front of the file).
  * "line" does not need to be allocated, but can't be another line in a
@@ -2572,6 +2695,11 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
     if (lnum > buf->b_ml.ml_line_count || buf->b_ml.ml_mfp == NULL)
 	return FAIL;
 
+#ifdef FEAT_MMAP_LOAD
+    if (buf->b_ml.ml_map != NULL && ml_map_load(buf) == FAIL)
+	return FAIL;
+#endif
+
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked = lnum + 1;
 
@@ -3067,6 +3195,11 @@ ml_replace(lnum, line, copy)
     if (curbuf->b_ml.ml_mfp == NULL && open_buffer(FALSE, NULL, 0) == FAIL)
 	return FAIL;
 
+#ifdef FEAT_MMAP_LOAD
+    if (curbuf->b_ml.ml_map != NULL && ml_map_load(curbuf) == FAIL)
+	return FAIL;
+#endif
+
     if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
 	return FAIL;
 #ifdef FEAT_NETBEANS_INTG
@@ -3126,6 +3259,11 @@ ml_delete_int(buf, lnum, message)
     if (lnum < 1 || lnum > buf->b_ml.ml_line_count)
 	return FAIL;
 
+#ifdef FEAT_MMAP_LOAD
+    if (buf->b_ml.ml_map != NULL && ml_map_load(buf) == FAIL)
+	return FAIL;
+#endif
+
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked--;
 
@@ -3278,6 +3416,12 @@ ml_setmarked(lnum)
 					       || curbuf->b_ml.ml_mfp == NULL)
 	return;			    /* give error message? */
 
+#ifdef FEAT_MMAP_LOAD
+    /* Marks are kept in the data blocks, load a mapped file first. */
+    if (curbuf->b_ml.ml_map != NULL && ml_map_load(curbuf) == FAIL)
+	return;
+#endif
+
     if (lowest_marked == 0 || lowest_marked > lnum)
 	lowest_marked = lnum;
 
@@ -3307,6 +3451,10 @@ ml_firstmarked()
 
     if (curbuf->b_ml.ml_mfp == NULL)
 	return (linenr_T) 0;
+#ifdef FEAT_MMAP_LOAD
+    if (curbuf->b_ml.ml_map != NULL)	/* nothing can be marked */
+	return (linenr_T) 0;
+#endif
 
     /*
      * The search starts with lowest_marked line. This is the last line where
@@ -3351,6 +3499,13 @@ ml_clearmarked()
 
     if (curbuf->b_ml.ml_mfp == NULL)	    /* nothing to do */
 	return;
+#ifdef FEAT_MMAP_LOAD
+    if (curbuf->b_ml.ml_map != NULL)	    /* nothing can be marked */
+    {
+	lowest_marked = 0;
+	return;
+    }
+#endif
 
     /*
      * The search starts with line lowest_marked.
@@ -3568,19 +3723,30 @@ ml_find_line(buf, lnum, action)
 
     mfp = buf->b_ml.ml_mfp;
 
+    /* Line numbers are going to change, the index becomes invalid. */
+    if (action == ML_INSERT || action == ML_DELETE)
+    {
+	buf->b_ml.ml_index_len = 0;
+	buf->b_ml.ml_root_count = 0;
+    }
+
     /*
      * If there is a locked block check if the wanted line is in it.
      * If not, flush and release the locked block.
      * Don't do this for ML_INSERT_SAME, because the stack need to be updated.
      * Don't do this for ML_FLUSH, because we want to flush the locked block.
      * Don't do this when 'swapfile' is reset, we want to load all the blocks.
+     * Don't insert or delete when the block was found through ml_index, the
+     * stack is needed to update the pointer blocks.
      */
     if (buf->b_ml.ml_locked)
     {
 	if (ML_SIMPLE(action)
 		&& buf->b_ml.ml_locked_low <= lnum
 		&& buf->b_ml.ml_locked_high >= lnum
-		&& !mf_dont_release)
+		&& !mf_dont_release
+		&& (action == ML_FIND
+			   || !(buf->b_ml.ml_flags & ML_LOCKED_NOSTACK)))
 	{
 	    /* remember to update pointer blocks and stack later */
 	    if (action == ML_INSERT)
@@ -3593,6 +3759,7 @@ ml_find_line(buf, lnum, action)
 		--(buf->b_ml.ml_locked_lineadd);
 		--(buf->b_ml.ml_locked_high);
 	    }
+	    ++buf->b_ml.ml_find_locked;
 	    return (buf->b_ml.ml_locked);
 	}
 
@@ -3632,9 +3799,32 @@ ml_find_line(buf, lnum, action)
 	}
 	if (top < 0)
 	    buf->b_ml.ml_stack_top = 0;		/* not found, start at the root */
+
+	if (top > 0)
+	    ++buf->b_ml.ml_find_stack;
+	else
+	{
+	    /* Would have to start at the root.  When this happens often the
+	     * lines are used in random order, use an index of the data
+	     * blocks to avoid going through the pointer blocks. */
+	    if (buf->b_ml.ml_index_len == 0
+			       && buf->b_ml.ml_root_count == ML_INDEX_MIN)
+		ml_index_build(buf);
+	    if (buf->b_ml.ml_index_len > 0
+			       && (hp = ml_index_find(buf, lnum)) != NULL)
+	    {
+		++buf->b_ml.ml_find_index;
+		return hp;
+	    }
+	    ++buf->b_ml.ml_find_root;
+	    ++buf->b_ml.ml_root_count;
+	}
     }
     else	/* ML_DELETE or ML_INSERT */
+    {
 	buf->b_ml.ml_stack_top = 0;	/* start at the root */
+	++buf->b_ml.ml_find_root;
+    }
 
 /*
  * search downwards in the tree until a data block is found
@@ -3659,7 +3849,14 @@ ml_find_line(buf, lnum, action)
 	    buf->b_ml.ml_locked_low = low;
 	    buf->b_ml.ml_locked_high = high;
 	    buf->b_ml.ml_locked_lineadd = 0;
-	    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+	    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS
+							 | ML_LOCKED_NOSTACK);
+
+	    /* The block number in the index may have been translated. */
+	    if (buf->b_ml.ml_index_len > 0
+		    && (idx = ml_index_lookup(buf, low)) >= 0
+		    && buf->b_ml.ml_index[idx].mi_low == low)
+		buf->b_ml.ml_index[idx].mi_bnum = bnum;
 	    return hp;
 	}
 
@@ -3747,6 +3944,182 @@ error_noblock:
     return NULL;
 }
 
+/*
+ * Build the index of data blocks for "buf" by going through the pointer
+ * blocks.  All data blocks are at the same depth in the tree, thus the data
+ * blocks themselves don't need to be read.
+ * Must not be called while a block is locked.
+ */
+    static void
+ml_index_build(buf)
+    buf_T	*buf;
+{
+    memfile_T	*mfp = buf->b_ml.ml_mfp;
+    bhdr_T	*hp;
+    PTR_BL	*pp;
+    blocknr_T	bnum = 1;
+    int		page_count = 1;
+    int		depth = 0;
+
+    /* Find the depth of the data blocks by following the first entries. */
+    for (;;)
+    {
+	if ((hp = mf_get(mfp, bnum, page_count)) == NULL)
+	    return;
+	pp = (PTR_BL *)(hp->bh_data);
+	if (pp->pb_id != PTR_ID)
+	{
+	    mf_put(mfp, hp, FALSE, FALSE);
+	    break;
+	}
+	++depth;
+	bnum = pp->pb_pointer[0].pe_bnum;
+	page_count = pp->pb_pointer[0].pe_page_count;
+	mf_put(mfp, hp, FALSE, FALSE);
+    }
+
+    if (depth == 0 || ml_index_add(buf, (blocknr_T)1, (linenr_T)1, depth)
+									== FAIL
+	    || buf->b_ml.ml_index[buf->b_ml.ml_index_len - 1].mi_low
+						     > buf->b_ml.ml_line_count)
+	buf->b_ml.ml_index_len = 0;
+}
+
+/*
+ * Add the data blocks below pointer block "bnum", which starts at line
+ * "low" and has "depth" levels of pointer blocks, to the index.
+ */
+    static int
+ml_index_add(buf, bnum, low, depth)
+    buf_T	*buf;
+    blocknr_T	bnum;
+    linenr_T	low;
+    int		depth;
+{
+    memfile_T	*mfp = buf->b_ml.ml_mfp;
+    bhdr_T	*hp;
+    PTR_BL	*pp;
+    PTR_EN	*pe;
+    mlindex_T	*mi;
+    int		idx;
+    int		ret = OK;
+
+    if ((hp = mf_get(mfp, bnum, 1)) == NULL)
+	return FAIL;
+    pp = (PTR_BL *)(hp->bh_data);
+    if (pp->pb_id != PTR_ID)
+	ret = FAIL;
+    for (idx = 0; ret == OK && idx < (int)pp->pb_count; ++idx)
+    {
+	pe = &pp->pb_pointer[idx];
+	if (depth > 1)
+	    ret = ml_index_add(buf, pe->pe_bnum, low, depth - 1);
+	else
+	{
+	    if (buf->b_ml.ml_index_len == buf->b_ml.ml_index_size)
+	    {
+		int n = buf->b_ml.ml_index_size == 0 ? 100
+					       : buf->b_ml.ml_index_size * 2;
+
+		mi = (mlindex_T *)alloc((unsigned)(n * sizeof(mlindex_T)));
+		if (mi == NULL)
+		{
+		    ret = FAIL;
+		    break;
+		}
+		if (buf->b_ml.ml_index != NULL)
+		    mch_memmove(mi, buf->b_ml.ml_index,
+			      (size_t)buf->b_ml.ml_index_len * sizeof(mlindex_T));
+		vim_free(buf->b_ml.ml_index);
+		buf->b_ml.ml_index = mi;
+		buf->b_ml.ml_index_size = n;
+	    }
+	    mi = &buf->b_ml.ml_index[buf->b_ml.ml_index_len++];
+	    mi->mi_low = low;
+	    mi->mi_bnum = pe->pe_bnum;
+	    mi->mi_page_count = pe->pe_page_count;
+	}
+	low += pe->pe_line_count;
+    }
+    mf_put(mfp, hp, FALSE, FALSE);
+    return ret;
+}
+
+/*
+ * Return the index in ml_index of the data block containing line "lnum".
+ * Returns -1 if the index is empty.
+ */
+    static int
+ml_index_lookup(buf, lnum)
+    buf_T	*buf;
+    linenr_T	lnum;
+{
+    mlindex_T	*mi = buf->b_ml.ml_index;
+    int		bot = 0;
+    int		top = buf->b_ml.ml_index_len - 1;
+    int		mid;
+
+    if (top < 0 || lnum < mi[0].mi_low)
+	return -1;
+    while (bot < top)
+    {
+	mid = (bot + top + 1) / 2;
+	if (mi[mid].mi_low <= lnum)
+	    bot = mid;
+	else
+	    top = mid - 1;
+    }
+    return bot;
+}
+
+/*
+ * Find the data block with line "lnum" using ml_index and make it the locked
+ * block.  The stack is not set.
+ * Returns NULL when this didn't work, the tree must be searched then.
+ */
+    static bhdr_T *
+ml_index_find(buf, lnum)
+    buf_T	*buf;
+    linenr_T	lnum;
+{
+    bhdr_T	*hp;
+    mlindex_T	*mi;
+    linenr_T	high;
+    int		idx;
+
+    if ((idx = ml_index_lookup(buf, lnum)) < 0
+				       || lnum > buf->b_ml.ml_line_count)
+	return NULL;
+    mi = &buf->b_ml.ml_index[idx];
+    if (idx + 1 < buf->b_ml.ml_index_len)
+	high = mi[1].mi_low - 1;
+    else
+	high = buf->b_ml.ml_line_count;
+
+    /* A negative block number doesn't work after it was translated. */
+    if ((hp = mf_get(buf->b_ml.ml_mfp, mi->mi_bnum, mi->mi_page_count))
+								       == NULL)
+	return NULL;
+    if (((DATA_BL *)(hp->bh_data))->db_id != DATA_ID
+	    || ((DATA_BL *)(hp->bh_data))->db_line_count
+					       != (linenr_T)(high - mi->mi_low + 1))
+    {
+	/* Should not happen, stop using the index. */
+	mf_put(buf->b_ml.ml_mfp, hp, FALSE, FALSE);
+	buf->b_ml.ml_index_len = 0;
+	return NULL;
+    }
+
+    buf->b_ml.ml_stack_top = 0;
+    buf->b_ml.ml_locked = hp;
+    buf->b_ml.ml_locked_low = mi->mi_low;
+    buf->b_ml.ml_locked_high = high;
+    buf->b_ml.ml_locked_lineadd = 0;
+    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+    buf->b_ml.ml_flags |= ML_LOCKED_NOSTACK;
+    return hp;
+}
+
 /*
  * add an entry to the info pointer stack
  *
@@ -3802,6 +4175,7 @@ ml_lineadd(buf, count)
     memfile_T	*mfp = buf->b_ml.ml_mfp;
     bhdr_T	*hp;
 
+    buf->b_ml.ml_index_len = 0;
     for (idx = buf->b_ml.ml_stack_top - 1; idx >= 0; --idx)
     {
 	ip = &(buf->b_ml.ml_stack[idx]);
@@ -4937,6 +5311,7 @@ ml_updatechunk(buf, line, len, updtype)
 	buf->b_ml.ml_usedchunks = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize = 1;
+	buf->b_ml.ml_chunktree_ok = FALSE;
     }
 
     if (updtype == ML_CHNK_UPDLINE && buf->b_ml.ml_line_count == 1)
@@ -4948,6 +5323,7 @@ ml_updatechunk(buf, line, len, updtype)
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize =
 				  (long)STRLEN(buf->b_ml.ml_line_ptr) + 1;
+	buf->b_ml.ml_chunktree_ok = FALSE;
 	return;
     }
 
@@ -4957,15 +5333,7 @@ ml_updatechunk(buf, line, len, updtype)
      */
     if (buf != ml_upd_lastbuf || line != ml_upd_lastline + 1
 	    || updtype != ML_CHNK_ADDLINE)
-    {
-	for (curline = 1, curix = 0;
-	     curix < buf->b_ml.ml_usedchunks - 1
-	     && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	     curix++)
-	{
-	    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	}
-    }
+	curix = ml_chunk_find(buf, line, 0L, FALSE, &curline, NULL);
     else if (line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines
 		 && curix < buf->b_ml.ml_usedchunks - 1)
     {
@@ -4978,6 +5346,8 @@ ml_updatechunk(buf, line, len, updtype)
     if (updtype == ML_CHNK_DELLINE)
 	len = -len;
     curchnk->mlcs_totalsize += len;
+    ml_chunk_add(buf, curix, updtype == ML_CHNK_ADDLINE ? 1
+			       : updtype == ML_CHNK_DELLINE ? -1 : 0, len);
     if (updtype == ML_CHNK_ADDLINE)
     {
 	curchnk->mlcs_numlines++;
@@ -5047,6 +5417,7 @@ ml_updatechunk(buf, line, len, updtype)
 	    buf->b_ml.ml_chunksize[curix].mlcs_totalsize = size;
 	    buf->b_ml.ml_chunksize[curix + 1].mlcs_totalsize -= size;
 	    buf->b_ml.ml_usedchunks++;
+	    buf->b_ml.ml_chunktree_ok = FALSE;
 	    ml_upd_lastbuf = NULL;   /* Force recalc of curix & curline */
 	    return;
 	}
@@ -5060,6 +5431,7 @@ ml_updatechunk(buf, line, len, updtype)
 	     */
 	    curchnk = buf->b_ml.ml_chunksize + curix + 1;
 	    buf->b_ml.ml_usedchunks++;
+	    buf->b_ml.ml_chunktree_ok = FALSE;
 	    if (line == buf->b_ml.ml_line_count)
 	    {
 		curchnk->mlcs_numlines = 0;
@@ -5095,6 +5467,8 @@ ml_updatechunk(buf, line, len, updtype)
     {
 	curchnk->mlcs_numlines--;
 	ml_upd_lastbuf = NULL;   /* Force recalc of curix & curline */
+	/* From here on chunks are moved, the tree needs to be rebuilt.  When
+	 * returning early the change was already added to it. */
 	if (curix < (buf->b_ml.ml_usedchunks - 1)
 		&& (curchnk->mlcs_numlines + curchnk[1].mlcs_numlines)
 		   <= MLCS_MINL)
@@ -5107,6 +5481,7 @@ ml_updatechunk(buf, line, len, updtype)
 	    buf->b_ml.ml_usedchunks--;
 	    mch_memmove(buf->b_ml.ml_chunksize, buf->b_ml.ml_chunksize + 1,
 			buf->b_ml.ml_usedchunks * sizeof(chunksize_T));
+	    buf->b_ml.ml_chunktree_ok = FALSE;
 	    return;
 	}
 	else if (curix == 0 || (curchnk->mlcs_numlines > 10
@@ -5120,6 +5495,7 @@ ml_updatechunk(buf, line, len, updtype)
 	curchnk[-1].mlcs_numlines += curchnk->mlcs_numlines;
 	curchnk[-1].mlcs_totalsize += curchnk->mlcs_totalsize;
 	buf->b_ml.ml_usedchunks--;
+	buf->b_ml.ml_chunktree_ok = FALSE;
 	if (curix < buf->b_ml.ml_usedchunks)
 	{
 	    mch_memmove(buf->b_ml.ml_chunksize + curix,
@@ -5135,6 +5511,135 @@ ml_updatechunk(buf, line, len, updtype)
     ml_upd_lastcurix = curix;
 }
 
+/*
+ * (Re)build the Fenwick tree of chunk sizes: entry "i" holds the sum of the
+ * "i & -i" chunks up to and including chunk "i - 1".  This makes updating a
+ * chunk and finding a chunk by line number or offset take O(log n) time.
+ * Returns FAIL when out of memory.
+ */
+    static int
+ml_chunk_build(buf)
+    buf_T	*buf;
+{
+    chunksize_T	*tree;
+    int		n = buf->b_ml.ml_usedchunks;
+    int		i, j;
+
+    if (buf->b_ml.ml_chunktree_size < n + 1)
+    {
+	vim_free(buf->b_ml.ml_chunktree);
+	buf->b_ml.ml_chunktree_size = 0;
+	buf->b_ml.ml_chunktree = (chunksize_T *)alloc((unsigned)
+			   (sizeof(chunksize_T) * (buf->b_ml.ml_numchunks + 1)));
+	if (buf->b_ml.ml_chunktree == NULL)
+	    return FAIL;
+	buf->b_ml.ml_chunktree_size = buf->b_ml.ml_numchunks + 1;
+    }
+    tree = buf->b_ml.ml_chunktree;
+
+    mch_memmove(tree + 1, buf->b_ml.ml_chunksize, n * sizeof(chunksize_T));
+    for (i = 1; i <= n; ++i)
+    {
+	j = i + (i & -i);
+	if (j <= n)
+	{
+	    tree[j].mlcs_numlines += tree[i].mlcs_numlines;
+	    tree[j].mlcs_totalsize += tree[i].mlcs_totalsize;
+	}
+    }
+    buf->b_ml.ml_chunktree_ok = TRUE;
+    return OK;
+}
+
+/*
+ * Add "lines" and "size" to chunk "ix" in the Fenwick tree.  Does nothing when
+ * the tree is going to be rebuilt anyway.
+ */
+    static void
+ml_chunk_add(buf, ix, lines, size)
+    buf_T	*buf;
+    int		ix;
+    int		lines;
+    long	size;
+{
+    int		i;
+
+    if (!buf->b_ml.ml_chunktree_ok)
+	return;
+    for (i = ix + 1; i <= buf->b_ml.ml_usedchunks; i += i & -i)
+    {
+	buf->b_ml.ml_chunktree[i].mlcs_numlines += lines;
+	buf->b_ml.ml_chunktree[i].mlcs_totalsize += size;
+    }
+}
+
+/*
+ * Find the chunk that contains line "lnum", or byte "offset" when "lnum" is
+ * zero.  The last chunk is used when going past the end.  Sets "*curlinep"
+ * to the first line of the chunk and "*sizep", if not NULL, to the number of
+ * bytes before it.  When searching for "offset" with "ffdos" set this
+ * includes a CR for every line.
+ * Returns the index of the chunk.
+ */
+    static int
+ml_chunk_find(buf, lnum, offset, ffdos, curlinep, sizep)
+    buf_T	*buf;
+    linenr_T	lnum;
+    long	offset;
+    int		ffdos;
+    linenr_T	*curlinep;
+    long	*sizep;
+{
+    chunksize_T	*cs;
+    int		n = buf->b_ml.ml_usedchunks - 1;  /* never skip the last one */
+    int		curix = 0;
+    int		step;
+    linenr_T	curline = 0;
+    long	size = 0;
+
+    if (!ffdos || lnum != 0)
+	ffdos = 0;
+    if (buf->b_ml.ml_chunktree_ok || ml_chunk_build(buf) == OK)
+    {
+	cs = buf->b_ml.ml_chunktree;
+	for (step = 1; step * 2 <= n; step *= 2)
+	    ;
+	for ( ; step > 0; step /= 2)
+	    if (curix + step <= n
+		    && (lnum != 0
+			? curline + cs[curix + step].mlcs_numlines < lnum
+			: size + cs[curix + step].mlcs_totalsize
+			      + ffdos * (curline + cs[curix + step].mlcs_numlines)
+								    < offset))
+	    {
+		curix += step;
+		curline += cs[curix].mlcs_numlines;
+		size += cs[curix].mlcs_totalsize;
+	    }
+    }
+    else
+    {
+	/* Out of memory for the tree, go through the chunks one by one. */
+	cs = buf->b_ml.ml_chunksize;
+	while (curix < n
+		&& (lnum != 0
+		    ? curline + cs[curix].mlcs_numlines < lnum
+		    : size + cs[curix].mlcs_totalsize
+			      + ffdos * (curline + cs[curix].mlcs_numlines)
+								    < offset))
+	{
+	    curline += cs[curix].mlcs_numlines;
+	    size += cs[curix].mlcs_totalsize;
+	    ++curix;
+	}
+    }
+
+    *curlinep = curline + 1;
+    if (sizep != NULL)
+	*sizep = size + ffdos * curline;
+    return curix;
+}
+
 /*
  * Find offset for line or line with offset.
  * Find line with offset if "lnum" is 0; return remaining offset in offp
@@ -5148,7 +5653,6 @@ ml_find_line_or_offset(buf, lnum, offp)
     long	*offp;
 {
     linenr_T	curline;
-    int		curix;
     long	size;
     bhdr_T	*hp;
     DATA_BL	*dp;
@@ -5164,6 +5668,11 @@ ml_find_line_or_offset(buf, lnum, offp)
     /* take care of cached line first */
     ml_flush_line(curbuf);
 
+#ifdef FEAT_MMAP_LOAD
+    if (buf->b_ml.ml_map != NULL)
+	return ml_map_find_offset(buf, lnum, offp);
+#endif
+
     if (buf->b_ml.ml_usedchunks == -1
 	    || buf->b_ml.ml_chunksize == NULL
 	    || lnum < 0)
@@ -5176,24 +5685,10 @@ ml_find_line_or_offset(buf, lnum, offp)
     if (lnum == 0 && offset <= 0)
 	return 1;   /* Not a "find offset" and offset 0 _must_ be in line 1 */
     /*
-     * Find the last chunk before the one containing our line. Last chunk is
-     * special because it will never qualify
+     * Find the chunk containing our line or offset.  The lines in it are
+     * counted below.
      */
-    curline = 1;
-    curix = size = 0;
-    while (curix < buf->b_ml.ml_usedchunks - 1
-	    && ((lnum != 0
-	     && lnum >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
-		|| (offset != 0
-	       && offset > size + buf->b_ml.ml_chunksize[curix].mlcs_totalsize
-		      + ffdos * buf->b_ml.ml_chunksize[curix].mlcs_numlines)))
-    {
-	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	size += buf->b_ml.ml_chunksize[curix].mlcs_totalsize;
-	if (offset && ffdos)
-	    size += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	curix++;
-    }
+    (void)ml_chunk_find(buf, lnum, offset, ffdos, &curline, &size);
 
     while ((lnum != 0 && curline < lnum) || (offset != 0 && size < offset))
     {
@@ -5305,3 +5800,389 @@ goto_byte(cnt)
 # endif
 }
 #endif
+
+#if defined(FEAT_MMAP_LOAD) || defined(PROTO)
+/*
+ * Let the lines of "buf" come from the file mapped in "map".  The buffer
+ * must be empty.  "map" is freed when the buffer is closed.
+ */
+    void
+ml_map_attach(buf, map)
+    buf_T	*buf;
+    mlmap_T	*map;
+{
+    ml_flush_line(buf);
+    buf->b_ml.ml_map = map;
+    buf->b_ml.ml_line_count = map->mm_lines;
+    buf->b_ml.ml_line_lnum = 0;
+    buf->b_ml.ml_flags &= ~ML_EMPTY;
+}
+
+/*
+ * Copy all the lines of a mapped buffer into its memfile, so that they can
+ * be changed, and release the mapping.
+ * Return FAIL when out of memory, the buffer is still mapped then.
+ */
+    int
+ml_map_load(buf)
+    buf_T	*buf;
+{
+    mlmap_T	*map = buf->b_ml.ml_map;
+    linenr_T	lnum;
+    char_u	*line;
+
+    if (map == NULL)
+	return OK;
+
+    /* The memfile still holds the single empty line of the buffer before
+     * the file was read, insert the text above it. */
+    buf->b_ml.ml_map = NULL;
+    buf->b_ml.ml_line_count = 1;
+    buf->b_ml.ml_line_lnum = 0;
+    for (lnum = 1; lnum <= map->mm_lines; ++lnum)
+    {
+	line = ml_map_get(map, lnum);
+	if (line == NULL || ml_append_int(buf, lnum - 1, line, (colnr_T)0,
+						      TRUE, FALSE) == FAIL)
+	    break;
+    }
+
+    if (lnum <= map->mm_lines)
+    {
+	/* Out of memory: go back to using the mapping. */
+	while (buf->b_ml.ml_line_count > 1)
+	    (void)ml_delete_int(buf, (linenr_T)1, FALSE);
+	buf->b_ml.ml_map = map;
+	buf->b_ml.ml_line_count = map->mm_lines;
+	buf->b_ml.ml_line_lnum = 0;
+	return FAIL;
+    }
+
+    (void)ml_delete_int(buf, buf->b_ml.ml_line_count, FALSE);
+    ml_map_free(map);
+    return OK;
+}
+
+/*
+ * Forget the lines of a mapped buffer, leaving it empty.  Used when the
+ * mapped file was changed by another program, its text can't be trusted.
+ */
+    void
+ml_map_discard(buf)
+    buf_T	*buf;
+{
+    mlmap_T	*map = buf->b_ml.ml_map;
+
+    if (map == NULL)
+	return;
+    buf->b_ml.ml_map = NULL;
+    buf->b_ml.ml_line_count = 1;
+    buf->b_ml.ml_line_lnum = 0;
+    buf->b_ml.ml_flags |= ML_EMPTY;
+    ml_map_free(map);
+}
+
+/*
+ * Unmap the file of "map" and free all memory used for it.
+ */
+    void
+ml_map_free(map)
+    mlmap_T	*map;
+{
+    int		i;
+
+    if (map == NULL)
+	return;
+    mch_unmap_file(map->mm_addr, map->mm_size);
+    vim_free(map->mm_index);
+    for (i = 0; i < MLMAP_LINES; ++i)
+	vim_free(map->mm_line[i]);
+    vim_free(map);
+}
+
+/*
+ * Return the offset in the mapped file where line "lnum" starts.  For the
+ * line after the last one this is where it would start if the last line
+ * had an end-of-line.
+ */
+    static size_t
+ml_map_offset(map, lnum)
+    mlmap_T	*map;
+    linenr_T	lnum;
+{
+    linenr_T	l;
+    size_t	off;
+    char_u	*p;
+
+    if (lnum > map->mm_lines)
+	return map->mm_len + (map->mm_noeol
+			     ? 1 + (map->mm_fileformat == EOL_DOS) : 0);
+
+    /* Start at the closest indexed line, or at the line after the one
+     * looked up last when that is closer. */
+    l = (lnum - 1) / MLMAP_STEP * MLMAP_STEP + 1;
+    off = map->mm_index[(lnum - 1) / MLMAP_STEP];
+    if (map->mm_lnum > l && map->mm_lnum <= lnum)
+    {
+	l = map->mm_lnum;
+	off = map->mm_off;
+    }
+    while (l < lnum)
+    {
+	p = (char_u *)memchr(map->mm_addr + off, NL, map->mm_len - off);
+	if (p == NULL)		/* file was truncated?! */
+	    return map->mm_len;
+	off = (size_t)(p - map->mm_addr) + 1;
+	++l;
+    }
+    map->mm_lnum = lnum;
+    map->mm_off = off;
+    return off;
+}
+
+/*
+ * Return the byte offset of line "lnum" as counted in the buffer, where
+ * every line break takes one byte, two when "ffdos" is set.
+ */
+    static long
+ml_map_boff(map, lnum, ffdos)
+    mlmap_T	*map;
+    linenr_T	lnum;
+    int		ffdos;
+{
+    return (long)ml_map_offset(map, lnum) + (long)(lnum - 1)
+			     * (ffdos - (map->mm_fileformat == EOL_DOS));
+}
+
+/*
+ * Get a copy of line "lnum" from the mapped file.  The copy is valid until
+ * MLMAP_LINES other lines have been obtained.
+ * Returns NULL when out of memory.
+ */
+    static char_u *
+ml_map_get(map, lnum)
+    mlmap_T	*map;
+    linenr_T	lnum;
+{
+    size_t	off;
+    char_u	*start;
+    char_u	*end;
+    char_u	*p;
+    int		len;
+    int		idx;
+    int		i;
+
+    off = ml_map_offset(map, lnum);
+    start = map->mm_addr + off;
+    end = (char_u *)memchr(start, NL, map->mm_len - off);
+    if (end == NULL)
+	end = map->mm_addr + map->mm_len;
+    else
+    {
+	/* next ml_map_offset() for the following line is cheap */
+	map->mm_lnum = lnum + 1;
+	map->mm_off = (size_t)(end - map->mm_addr) + 1;
+	if (map->mm_fileformat == EOL_DOS && end > start && end[-1] == CAR)
+	    --end;
+    }
+    len = (int)(end - start);
+
+    idx = (map->mm_lineidx + 1) % MLMAP_LINES;
+    if (map->mm_linesize[idx] < len + 1)
+    {
+	vim_free(map->mm_line[idx]);
+	map->mm_line[idx] = alloc((unsigned)len + 1);
+	if (map->mm_line[idx] == NULL)
+	{
+	    map->mm_linesize[idx] = 0;
+	    return NULL;
+	}
+	map->mm_linesize[idx] = len + 1;
+    }
+    map->mm_lineidx = idx;
+
+    p = map->mm_line[idx];
+    for (i = 0; i < len; ++i)
+	p[i] = start[i] == NUL ? NL : start[i];	/* NULs are stored as NLs */
+    p[len] = NUL;
+    return p;
+}
+
+/*
+ * Return the number of the line in the mapped file that contains byte "off".
+ */
+    static linenr_T
+ml_map_lnum(map, off)
+    mlmap_T	*map;
+    size_t	off;
+{
+    long	lo, hi, mid;
+    linenr_T	lnum;
+    char_u	*p;
+    char_u	*end = map->mm_addr + off;
+
+    lo = 0;
+    hi = (map->mm_lines - 1) / MLMAP_STEP;
+    while (lo < hi)
+    {
+	mid = (lo + hi + 1) / 2;
+	if (map->mm_index[mid] <= off)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    lnum = (linenr_T)(lo * MLMAP_STEP + 1);
+    p = map->mm_addr + map->mm_index[lo];
+    while ((p = (char_u *)memchr(p, NL, end - p)) != NULL)
+    {
+	++p;
+	++lnum;
+    }
+    return lnum;
+}
+
+/*
+ * Return a pointer to the first "text" of "len" bytes in the "size" bytes at
+ * "p", NULL when not found.
+ */
+    static char_u *
+ml_map_search(p, size, text, len)
+    char_u	*p;
+    size_t	size;
+    char_u	*text;
+    int		len;
+{
+    char_u	*end = p + size;
+
+    while ((size_t)(end - p) >= (size_t)len
+	    && (p = (char_u *)memchr(p, *text, end - p - len + 1)) != NULL)
+    {
+	if (memcmp(p, text, (size_t)len) == 0)
+	    return p;
+	++p;
+    }
+    return NULL;
+}
+
+/*
+ * ml_find_text() for a mapped buffer: search the file text directly, a line
+ * never contains a line break of the file.
+ */
+    static linenr_T
+ml_map_find_text(map, lnum, dir, last, text, len)
+    mlmap_T	*map;
+    linenr_T	lnum;
+    int		dir;
+    linenr_T	last;
+    char_u	*text;
+    int		len;
+{
+    size_t	start;
+    size_t	end;
+    linenr_T	first;
+    char_u	*p;
+    char_u	*found;
+
+    /* A NUL in the file is a NL in the line, and a CR may have been
+     * dropped. */
+    if (len == 0 || memchr(text, NL, (size_t)len) != NULL
+				|| memchr(text, CAR, (size_t)len) != NULL)
+	return lnum;
+
+    if (dir == FORWARD)
+    {
+	start = ml_map_offset(map, lnum);
+	end = ml_map_offset(map, last + 1);
+	if (end > map->mm_len)
+	    end = map->mm_len;
+	p = ml_map_search(map->mm_addr + start, end - start, text, len);
+	if (p == NULL)
+	    return last + 1;
+	return ml_map_lnum(map, (size_t)(p - map->mm_addr));
+    }
+
+    /* Backwards: find the last one, going back one indexed stretch of lines
+     * at a time. */
+    end = ml_map_offset(map, lnum + 1);
+    if (end > map->mm_len)
+	end = map->mm_len;
+    while (lnum >= last)
+    {
+	first = (lnum - 1) / MLMAP_STEP * MLMAP_STEP + 1;
+	if (first < last)
+	    first = last;
+	start = ml_map_offset(map, first);
+	found = NULL;
+	p = map->mm_addr + start;
+	while ((p = ml_map_search(p, map->mm_addr + end - p, text, len))
+								      != NULL)
+	    found = p++;
+	if (found != NULL)
+	    return ml_map_lnum(map, (size_t)(found - map->mm_addr));
+	lnum = first - 1;
+	end = start;
+    }
+    return last - 1;
+}
+
+/*
+ * ml_find_line_or_offset() for a mapped buffer: the offsets are computed
+ * from where the lines are in the file.
+ */
+    static long
+ml_map_find_offset(buf, lnum, offp)
+    buf_T	*buf;
+    linenr_T	lnum;
+    long	*offp;
+{
+    mlmap_T	*map = buf->b_ml.ml_map;
+    int		ffdos = (get_fileformat(buf) == EOL_DOS);
+    long	offset;
+    long	size;
+    long	next;
+    long	lo, hi, mid;
+
+    if (lnum < 0 || lnum > buf->b_ml.ml_line_count + 1)
+	return -1;
+    if (lnum > 0)
+    {
+	size = ml_map_boff(map, lnum, ffdos);
+
+	/* Don't count the last line break if 'bin' and 'noeol'. */
+	if (buf->b_p_bin && !buf->b_p_eol)
+	    size -= ffdos + 1;
+	return size;
+    }
+
+    if (offp == NULL || *offp <= 0)
+	return 1;   /* Offset 0 _must_ be in line 1 */
+    offset = *offp;
+
+    /* Find the last indexed line that starts at or before "offset", then
+     * go through the lines from there. */
+    lo = 0;
+    hi = (map->mm_lines - 1) / MLMAP_STEP;
+    while (lo < hi)
+    {
+	mid = (lo + hi + 1) / 2;
+	if (ml_map_boff(map, (linenr_T)(mid * MLMAP_STEP + 1), ffdos)
+								    <= offset)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    lnum = (linenr_T)(lo * MLMAP_STEP + 1);
+    size = ml_map_boff(map, lnum, ffdos);
+    for ( ; lnum <= map->mm_lines; ++lnum)
+    {
+	next = ml_map_boff(map, lnum + 1, ffdos);
+	if (next > offset)
+	{
+	    *offp = offset - size;
+	    return lnum;
+	}
+	size = next;
+    }
+    return -1;		/* beyond the end */
+}
+#endif
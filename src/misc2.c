@@ -1907,7 +1907,9 @@ vim_strchr(string, c)
 	}
 	return NULL;
     }
-    if (has_mbyte)
+    /* In UTF-8 an ASCII byte is never part of another character, in a
+     * double-byte encoding it may be a trail byte. */
+    if (has_mbyte && !enc_utf8)
     {
 	while ((b = *p) != NUL)
 	{
@@ -1918,6 +1920,9 @@ vim_strchr(string, c)
 	return NULL;
     }
 #endif
+    /* The library function is much faster on long strings. */
+    if (c > 0 && c < 0x80)
+	return (char_u *)strchr((char *)p, c);
     while ((b = *p) != NUL)
     {
 	if (b == c)
@@ -1939,6 +1944,8 @@ vim_strbyte(string, c)
 {
     char_u	*p = string;
 
+    if (c > 0 && c < 0x80)
+	return (char_u *)strchr((char *)p, c);
     while (*p != NUL)
     {
 	if (*p == c)
@@ -1948,6 +1955,131 @@ vim_strbyte(string, c)
     return NULL;
 }
 
+/*
+ * Helpers for scanning big blocks of text, used when reading a file.  They
+ * look at sizeof(long_u) bytes at a time, only the bytes before the first
+ * aligned word and after the last one are checked one by one.
+ */
+#define WORD_SIZE	((int)sizeof(long_u))
+#define WORD_ONES	((long_u)-1 / 0xff)	/* 0x0101...01 */
+#define WORD_HIGHS	(WORD_ONES * 0x80)	/* 0x8080...80 */
+#define WORD_ALIGNED(p)	(((long_u)(p) & (WORD_SIZE - 1)) == 0)
+
+/* Non-zero when any byte in "w" is zero. */
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+/* Has 0x80 set in exactly the bytes of "w" that are zero. */
+#define WORD_ZERO_BYTES(w) \
+	(~((((w) & ~WORD_HIGHS) + ~WORD_HIGHS) | (w) | ~WORD_HIGHS))
+
+/*
+ * Find the first byte "c1" or "c2" in "len" bytes at "p".
+ * Return NULL if not found.
+ */
+    char_u *
+vim_memchr2(p, c1, c2, len)
+    char_u	*p;
+    int		c1;
+    int		c2;
+    size_t	len;
+{
+    char_u	*end = p + len;
+    long_u	w1 = WORD_ONES * (c1 & 0xff);
+    long_u	w2 = WORD_ONES * (c2 & 0xff);
+    long_u	w;
+
+    for ( ; p < end && !WORD_ALIGNED(p); ++p)
+	if (*p == c1 || *p == c2)
+	    return p;
+    for ( ; end - p >= WORD_SIZE; p += WORD_SIZE)
+    {
+	w = *(long_u *)p;
+	if (WORD_HAS_ZERO(w ^ w1) || WORD_HAS_ZERO(w ^ w2))
+	    break;
+    }
+    for ( ; p < end; ++p)
+	if (*p == c1 || *p == c2)
+	    return p;
+    return NULL;
+}
+
+/*
+ * Return the number of bytes "c" in "len" bytes at "p".
+ */
+    long
+vim_memcnt(p, c, len)
+    char_u	*p;
+    int		c;
+    size_t	len;
+{
+    char_u	*end = p + len;
+    long_u	wc = WORD_ONES * (c & 0xff);
+    long_u	w;
+    long	count = 0;
+
+    for ( ; p < end && !WORD_ALIGNED(p); ++p)
+	if (*p == c)
+	    ++count;
+    for ( ; end - p >= WORD_SIZE; p += WORD_SIZE)
+    {
+	w = *(long_u *)p ^ wc;
+	if (WORD_HAS_ZERO(w))
+	    /* Add up the 0x01 bytes in the top byte. */
+	    count += (long)(((WORD_ZERO_BYTES(w) >> 7) * WORD_ONES)
+						    >> ((WORD_SIZE - 1) * 8));
+    }
+    for ( ; p < end; ++p)
+	if (*p == c)
+	    ++count;
+    return count;
+}
+
+/*
+ * Return the number of bytes below 0x80 at the start of "len" bytes at "p".
+ */
+    size_t
+vim_ascii_len(p, len)
+    char_u	*p;
+    size_t	len;
+{
+    char_u	*s = p;
+    char_u	*end = p + len;
+
+    for ( ; s < end && !WORD_ALIGNED(s); ++s)
+	if (*s >= 0x80)
+	    return (size_t)(s - p);
+    for ( ; end - s >= WORD_SIZE; s += WORD_SIZE)
+	if (*(long_u *)s & WORD_HIGHS)
+	    break;
+    for ( ; s < end; ++s)
+	if (*s >= 0x80)
+	    break;
+    return (size_t)(s - p);
+}
+
+/*
+ * Return the number of bytes below 0x80 at the end of "len" bytes at "p".
+ */
+    size_t
+vim_ascii_len_back(p, len)
+    char_u	*p;
+    size_t	len;
+{
+    char_u	*end = p + len;
+    char_u	*s = end;
+
+    for ( ; s > p && !WORD_ALIGNED(s); --s)
+	if (s[-1] >= 0x80)
+	    return (size_t)(end - s);
+    for ( ; s - p >= WORD_SIZE; s -= WORD_SIZE)
+	if (*(long_u *)(s - WORD_SIZE) & WORD_HIGHS)
+	    break;
+    for ( ; s > p; --s)
+	if (s[-1] >= 0x80)
+	    break;
+    return (size_t)(end - s);
+}
+
 /*
  * Search for last occurrence of "c" in "string".
  * Return NULL if not found.
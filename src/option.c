@@ -1839,6 +1839,20 @@ static struct vimoption
 			    {(char_u *)0L, (char_u *)0L}
 #endif
 			    SCRIPTID_INIT},
+    {"mmapindex",   "mmi",  P_BOOL|P_VI_DEF,
+#ifdef FEAT_MMAP_LOAD
+			    (char_u *)&p_mmi, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)FALSE, (char_u *)0L} SCRIPTID_INIT},
+    {"mmapsize",    "mms",  P_NUM|P_VI_DEF,
+#ifdef FEAT_MMAP_LOAD
+			    (char_u *)&p_mms, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"modeline",    "ml",   P_BOOL|P_VIM,
 			    (char_u *)&p_ml, PV_ML,
 			    {(char_u *)FALSE, (char_u *)TRUE} SCRIPTID_INIT},
@@ -8641,6 +8655,13 @@ set_num_option(opt_idx, varp, value, errbuf, errbuflen, opt_flags)
 	errmsg = e_positive;
 	p_hi = 0;
     }
+#ifdef FEAT_MMAP_LOAD
+    if (p_mms < 0)
+    {
+	errmsg = e_positive;
+	p_mms = 0;
+    }
+#endif
     if (p_re < 0 || p_re > 2)
     {
 	errmsg = e_invarg;
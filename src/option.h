@@ -228,6 +228,7 @@
 #define GO_VLEFT	'L'		/* left scrollbar with vert split */
 #define GO_MENUS	'm'		/* use menu bar */
 #define GO_NOSYSMENU	'M'		/* don't source system menu */
+#define GO_OPENGL	'o'		/* draw the text area with OpenGL */
 #define GO_POINTER	'p'		/* pointer enter/leave callbacks */
 #define GO_ASELPLUS	'P'		/* autoselectPlus */
 #define GO_RIGHT	'r'		/* use right scrollbar */
@@ -236,7 +237,7 @@
 #define GO_TOOLBAR	'T'		/* add toolbar */
 #define GO_FOOTER	'F'		/* add footer */
 #define GO_VERTICAL	'v'		/* arrange dialog buttons vertically */
-#define GO_ALL		"aAbcefFghilmMprtTv" /* all possible flags for 'go' */
+#define GO_ALL		"aAbcefFghilmMoprtTv" /* all possible flags for 'go' */
 
 /* flags for 'comments' option */
 #define COM_NEST	'n'		/* comments strings nest */
@@ -628,6 +629,10 @@ EXTERN long	p_mis;		/* 'menuitems' */
 #ifdef FEAT_SPELL
 EXTERN char_u	*p_msm;		/* 'mkspellmem' */
 #endif
+#ifdef FEAT_MMAP_LOAD
+EXTERN int	p_mmi;		/* 'mmapindex' */
+EXTERN long	p_mms;		/* 'mmapsize' */
+#endif
 EXTERN long	p_mls;		/* 'modelines' */
 EXTERN char_u	*p_mouse;	/* 'mouse' */
 #ifdef FEAT_GUI
@@ -596,6 +596,39 @@ mch_total_mem(special)
     return (long_u)0x1fffff;
 # endif
 }
+#endif
+
+#if defined(FEAT_MMAP_LOAD) || defined(PROTO)
+/*
+ * Map "len" bytes of file descriptor "fd" into memory, read-only.
+ * Returns NULL when the file can't be mapped.
+ */
+    char_u *
+mch_map_file(fd, len)
+    int		fd;
+    size_t	len;
+{
+    void	*addr;
+
+    if (len == 0)
+	return NULL;
+    addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t)0);
+    if (addr == MAP_FAILED)
+	return NULL;
+    return (char_u *)addr;
+}
+
+/*
+ * Release a mapping obtained with mch_map_file().
+ */
+    void
+mch_unmap_file(addr, len)
+    char_u	*addr;
+    size_t	len;
+{
+    if (addr != NULL)
+	munmap((void *)addr, len);
+}
 #endif
 
     void
@@ -160,6 +160,14 @@
 # include <sys/time.h>
 #endif
 
+#ifdef FEAT_MMAP_LOAD
+# include <sys/mman.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+
 #include <signal.h>
 
 #if defined(DIRSIZ) && !defined(MAXNAMLEN)
@@ -28,6 +28,7 @@ void gui_mch_prepare __ARGS((int *argc, char **argv));
 int gui_mch_init_check __ARGS((void));
 int gui_mch_init __ARGS((void));
 int gui_mch_open __ARGS((void));
+void gui_mch_enable_opengl __ARGS((int enable));
 void gui_mch_exit __ARGS((int));
 int gui_mch_init_font __ARGS((char_u *font_name, int fontset));
 void gui_mch_set_font __ARGS((GuiFont font));
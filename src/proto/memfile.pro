@@ -11,6 +11,7 @@ void mf_free __ARGS((memfile_T *mfp, bhdr_T *hp));
 int mf_sync __ARGS((memfile_T *mfp, int flags));
 void mf_set_dirty __ARGS((memfile_T *mfp));
 int mf_release_all __ARGS((void));
+void mf_stats __ARGS((memfile_T *mfp, dict_T *d));
 blocknr_T mf_trans_del __ARGS((memfile_T *mfp, blocknr_T old_nr));
 void mf_set_ffname __ARGS((memfile_T *mfp));
 void mf_fullname __ARGS((memfile_T *mfp));
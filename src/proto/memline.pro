@@ -19,6 +19,7 @@ char_u *ml_get_curline __ARGS((void));
 char_u *ml_get_cursor __ARGS((void));
 char_u *ml_get_buf __ARGS((buf_T *buf, linenr_T lnum, int will_change));
 int ml_line_alloced __ARGS((void));
+linenr_T ml_find_text __ARGS((buf_T *buf, linenr_T lnum, int dir, linenr_T last, char_u *text, int len));
 int ml_append __ARGS((linenr_T lnum, char_u *line, colnr_T len, int newfile));
 int ml_append_buf __ARGS((buf_T *buf, linenr_T lnum, char_u *line, colnr_T len, int newfile));
 int ml_replace __ARGS((linenr_T lnum, char_u *line, int copy));
@@ -34,4 +35,8 @@ char_u *ml_encrypt_data __ARGS((memfile_T *mfp, char_u *data, off_t offset, unsi
 void ml_decrypt_data __ARGS((memfile_T *mfp, char_u *data, off_t offset, unsigned size));
 long ml_find_line_or_offset __ARGS((buf_T *buf, linenr_T lnum, long *offp));
 void goto_byte __ARGS((long cnt));
+void ml_map_attach __ARGS((buf_T *buf, mlmap_T *map));
+int ml_map_load __ARGS((buf_T *buf));
+void ml_map_discard __ARGS((buf_T *buf));
+void ml_map_free __ARGS((mlmap_T *map));
 /* vim: set ft=c : */
@@ -48,6 +48,10 @@ int vim_stricmp __ARGS((char *s1, char *s2));
 int vim_strnicmp __ARGS((char *s1, char *s2, size_t len));
 char_u *vim_strchr __ARGS((char_u *string, int c));
 char_u *vim_strbyte __ARGS((char_u *string, int c));
+char_u *vim_memchr2 __ARGS((char_u *p, int c1, int c2, size_t len));
+long vim_memcnt __ARGS((char_u *p, int c, size_t len));
+size_t vim_ascii_len __ARGS((char_u *p, size_t len));
+size_t vim_ascii_len_back __ARGS((char_u *p, size_t len));
 char_u *vim_strrchr __ARGS((char_u *string, int c));
 int vim_isspace __ARGS((int x));
 void ga_clear __ARGS((garray_T *gap));
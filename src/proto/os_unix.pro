@@ -4,6 +4,8 @@ void mch_write __ARGS((char_u *s, int len));
 int mch_inchar __ARGS((char_u *buf, int maxlen, long wtime, int tb_change_cnt));
 int mch_char_avail __ARGS((void));
 long_u mch_total_mem __ARGS((int special));
+char_u *mch_map_file __ARGS((int fd, size_t len));
+void mch_unmap_file __ARGS((char_u *addr, size_t len));
 void mch_delay __ARGS((long msec, int ignoreinput));
 int mch_stackcheck __ARGS((char *p));
 void mch_startjmp __ARGS((void));
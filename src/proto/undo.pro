@@ -8,6 +8,7 @@ int undo_allowed __ARGS((void));
 int u_savecommon __ARGS((linenr_T top, linenr_T bot, linenr_T newbot, int reload));
 void u_compute_hash __ARGS((char_u *hash));
 char_u *u_get_undo_file_name __ARGS((char_u *buf_ffname, int reading));
+char_u *u_get_udir_file_name __ARGS((char_u *buf_ffname, int reading, char_u *dot_ext, char_u *dir_ext));
 void u_write_undo __ARGS((char_u *name, int forceit, buf_T *buf, char_u *hash));
 void u_read_undo __ARGS((char_u *name, char_u *hash, char_u *orig_name));
 void u_undo __ARGS((int count));
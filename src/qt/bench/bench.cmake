@@ -0,0 +1,44 @@
+#
+# Run the qvim-bench rendering benchmark, invoked by the "bench" target as
+#	cmake -DQVIM_BENCH=<qvim-bench> -DBENCH_OUT=<file> -P bench.cmake
+#
+# Frames per second for each case are written to BENCH_OUT, paint op,
+# frame and allocation counts for each case are printed on exit.
+# This also works without a display, see below.
+#
+
+get_filename_component(BENCH_DIR ${CMAKE_CURRENT_LIST_FILE} PATH)
+
+set(ENV{QVIM_PAINT_STATS} 1)
+# Present every redraw as a frame, without pacing to the refresh rate
+set(ENV{QVIM_FRAME_INTERVAL} 0)
+# No display is needed: Qt 5 renders with the offscreen platform plugin,
+# Qt 4 on X11 gets a virtual X server from xvfb-run
+if(NOT DEFINED ENV{QT_QPA_PLATFORM})
+	set(ENV{QT_QPA_PLATFORM} offscreen)
+endif(NOT DEFINED ENV{QT_QPA_PLATFORM})
+set(BENCH_RUN ${QVIM_BENCH})
+if(UNIX AND NOT DEFINED ENV{DISPLAY})
+	find_program(XVFB_RUN xvfb-run)
+	if(XVFB_RUN)
+		set(BENCH_RUN ${XVFB_RUN} -a ${QVIM_BENCH})
+	endif(XVFB_RUN)
+endif(UNIX AND NOT DEFINED ENV{DISPLAY})
+# The syntax case needs the runtime files from this tree
+set(ENV{VIMRUNTIME} ${BENCH_DIR}/../../../runtime)
+file(REMOVE ${BENCH_OUT})
+
+foreach(CASE scroll syntax cjk)
+	message("Benchmark: ${CASE}")
+	execute_process(COMMAND ${BENCH_RUN} -g -f -u NONE -U NONE -N
+			--cmd "let g:bench_case='${CASE}'"
+			--cmd "let g:bench_out='${BENCH_OUT}'"
+			-S ${BENCH_DIR}/bench.vim
+			RESULT_VARIABLE BENCH_RESULT)
+	if(NOT BENCH_RESULT EQUAL 0)
+		message(FATAL_ERROR "Benchmark ${CASE} failed: ${BENCH_RESULT}")
+	endif(NOT BENCH_RESULT EQUAL 0)
+endforeach(CASE)
+
+file(READ ${BENCH_OUT} BENCH_RESULTS)
+message("${BENCH_RESULTS}")
@@ -0,0 +1,76 @@
+" Rendering benchmark for the Qt GUI
+"
+" Run by the "bench" target (see bench.cmake), one case per qvim-bench
+" process:
+"	qvim-bench -g -f -u NONE -U NONE -N --cmd "let g:bench_case='scroll'"
+"		--cmd "let g:bench_out='bench.txt'" -S bench.vim
+"
+" Each case drives the redraw code, i.e. gui_mch_draw_string(),
+" gui_mch_delete_lines(), gui_mch_insert_lines() and gui_mch_clear_block(),
+" and appends the number of frames per second to g:bench_out. Each :redraw
+" presents a frame, bench.cmake turns off the frame pacing. Paint op, frame
+" and allocation counts are printed by qvim-bench on exit.
+
+set nocompatible
+set encoding=utf-8
+set lines=50 columns=120
+set nohlsearch noshowcmd noruler laststatus=2
+
+let s:steps = exists('g:bench_steps') ? g:bench_steps : 2000
+
+" Redraw after each normal mode command in "cmds", returns frames/s
+func! s:Replay(cmds)
+  let start = reltime()
+  let frames = 0
+  for i in range(s:steps)
+    exe 'normal! ' . a:cmds[i % len(a:cmds)]
+    redraw
+    let frames += 1
+  endfor
+  let secs = str2float(reltimestr(reltime(start)))
+  return secs > 0 ? frames / secs : 0.0
+endfunc
+
+" Full redraws, as after ":syntax on" or a colorscheme change
+func! s:Redraw()
+  let start = reltime()
+  for i in range(s:steps / 10)
+    redraw!
+  endfor
+  let secs = str2float(reltimestr(reltime(start)))
+  return secs > 0 ? (s:steps / 10) / secs : 0.0
+endfunc
+
+func! s:Report(name, fps)
+  let lines = filereadable(g:bench_out) ? readfile(g:bench_out) : []
+  call add(lines, printf('%-12s %10.1f frames/s', a:name, a:fps))
+  call writefile(lines, g:bench_out)
+endfunc
+
+if g:bench_case == 'scroll'
+  " Scroll a 100k line file, a line and half a page at a time
+  call setline(1, map(range(1, 100000), 'printf("%6d  %s", v:val, repeat("The quick brown fox ", 5))'))
+  call s:Report('scroll-line', s:Replay(["\<C-E>", "\<C-E>", "\<C-E>", "\<C-Y>"]))
+  normal! gg
+  call s:Report('scroll-page', s:Replay(["\<C-D>"]))
+
+elseif g:bench_case == 'syntax'
+  " Highlighted C code
+  exe 'edit ' . fnameescape(expand('<sfile>:p:h:h:h') . '/screen.c')
+  syntax on
+  call s:Report('syntax', s:Redraw())
+  call s:Report('syntax-scroll', s:Replay(["\<C-E>", "\<C-E>", "\<C-Y>", "\<C-D>", "\<C-U>"]))
+
+elseif g:bench_case == 'cjk'
+  " Double width text, on its own and mixed with ASCII
+  let cjk = repeat("漢字かな交じり文", 7)
+  let mixed = repeat("ASCII 和文 mixed 한글 ", 6)
+  call setline(1, map(range(1, 10000), 'v:val % 2 ? cjk : mixed'))
+  call s:Report('cjk', s:Redraw())
+  call s:Report('cjk-scroll', s:Replay(["\<C-E>", "\<C-E>", "\<C-Y>", "\<C-D>"]))
+
+else
+  echoerr 'Unknown benchmark case: ' . g:bench_case
+endif
+
+qall!
@@ -0,0 +1,50 @@
+/*
+ * Hooks for qvim-bench, the rendering benchmark, see bench.vim.
+ * This file is only linked into qvim-bench, never into Vim.
+ *
+ * Every allocation made through operator new is counted, the
+ * count is printed when qvim-bench exits. Allocations made
+ * inside the Qt libraries are not seen.
+ */
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+
+#if __cplusplus >= 201103L
+# define BENCH_THROWS_BAD_ALLOC
+# define BENCH_NOTHROW noexcept
+#else
+# define BENCH_THROWS_BAD_ALLOC throw(std::bad_alloc)
+# define BENCH_NOTHROW throw()
+#endif
+
+static unsigned long allocations = 0;
+
+void* operator new(std::size_t size) BENCH_THROWS_BAD_ALLOC
+{
+	allocations++;
+	void *p = std::malloc(size ? size : 1);
+	if ( p == NULL ) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) BENCH_NOTHROW
+{
+	std::free(p);
+}
+
+/**
+ * Print the allocation count when the program exits
+ */
+class AllocationReport
+{
+public:
+	~AllocationReport()
+	{
+		std::fprintf(stderr, "Allocations: %lu\n", allocations);
+	}
+};
+
+static AllocationReport report;
@@ -0,0 +1,140 @@
+#include "glcanvas.h"
+
+#ifdef FEAT_GUI_QT_OPENGL
+
+#include "qvimshell.h"
+
+// Not in the OpenGL 1.1 headers shipped with some compilers
+#ifndef GL_BGRA
+# define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+# define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+# define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+GLCanvas::GLCanvas(QVimShell *shell)
+:QGLWidget(shell), m_shell(shell), m_texture(0)
+{
+	// Input goes to the shell underneath
+	setAttribute(Qt::WA_TransparentForMouseEvents, true);
+	setFocusPolicy(Qt::NoFocus);
+	setAutoFillBackground(false);
+}
+
+GLCanvas::~GLCanvas()
+{
+	if ( m_texture ) {
+		makeCurrent();
+		glDeleteTextures(1, &m_texture);
+	}
+}
+
+/**
+ * True if the platform has OpenGL at all
+ */
+bool GLCanvas::isSupported()
+{
+	return QGLFormat::hasOpenGL();
+}
+
+/**
+ * Check if we got a context we can draw with, we need
+ * OpenGL 2.0 for non power of two textures
+ */
+bool GLCanvas::isUsable()
+{
+	if ( !isValid() ) {
+		return false;
+	}
+
+	makeCurrent();
+	return QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_2_0;
+}
+
+/**
+ * Mark part of the canvas as changed
+ */
+void GLCanvas::updateCanvas(const QRect& rect)
+{
+	m_dirty += rect;
+	update();
+}
+
+void GLCanvas::initializeGL()
+{
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_textureSize = QSize();
+}
+
+void GLCanvas::resizeGL(int w, int h)
+{
+	glViewport(0, 0, w, h);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, w, h, 0, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+}
+
+void GLCanvas::paintGL()
+{
+	m_shell->flushPaintOps();
+
+	const QImage& canvas = m_shell->canvas();
+	if ( canvas.isNull() ) {
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+
+	// The canvas is QImage::Format_RGB32, i.e. 0xffRRGGBB words
+	if ( canvas.size() != m_textureSize ) {
+		m_textureSize = canvas.size();
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, canvas.bytesPerLine()/4);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, canvas.width(), canvas.height(), 0,
+				GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, canvas.constBits());
+	} else {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, canvas.bytesPerLine()/4);
+		foreach ( QRect rect, m_dirty.rects() ) {
+			rect &= canvas.rect();
+			if ( rect.isEmpty() ) {
+				continue;
+			}
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y(),
+					rect.width(), rect.height(),
+					GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+					canvas.constScanLine(rect.y()) + rect.x()*4);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	m_dirty = QRegion();
+
+	int w = canvas.width();
+	int h = canvas.height();
+
+	glEnable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex2i(0, 0);
+	glTexCoord2f(1, 0);
+	glVertex2i(w, 0);
+	glTexCoord2f(1, 1);
+	glVertex2i(w, h);
+	glTexCoord2f(0, 1);
+	glVertex2i(0, h);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
+}
+
+#endif // FEAT_GUI_QT_OPENGL
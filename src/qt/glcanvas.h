@@ -0,0 +1,41 @@
+#ifndef VIM_QT_GLCANVAS
+#define VIM_QT_GLCANVAS
+
+#ifdef FEAT_GUI_QT_OPENGL
+
+#include <QGLWidget>
+#include <QRegion>
+
+class QVimShell;
+
+/**
+ * OpenGL surface for the shell canvas
+ *
+ * Sits on top of the shell and keeps a copy of the shell canvas in a
+ * texture. Only the damaged parts of the canvas are uploaded, each
+ * frame is a single textured quad.
+ */
+class GLCanvas: public QGLWidget
+{
+public:
+	GLCanvas(QVimShell *shell);
+	~GLCanvas();
+
+	static bool isSupported();
+	bool isUsable();
+	void updateCanvas(const QRect&);
+
+protected:
+	void initializeGL();
+	void resizeGL(int w, int h);
+	void paintGL();
+
+private:
+	QVimShell *m_shell;
+	GLuint m_texture;
+	QSize m_textureSize;
+	QRegion m_dirty;
+};
+
+#endif // FEAT_GUI_QT_OPENGL
+#endif
@@ -13,9 +13,12 @@ extern "C" {
 }
 
 #include "colortable.h"
+#include "glcanvas.h"
 
 QVimShell::QVimShell(QWidget *parent)
 :QWidget(parent), m_encoding_utf8(true),
+	m_damageRowHeight(1), m_damageAll(false), m_dirty(false), m_glCanvas(NULL),
+	m_textFont(0), m_fontGeneration(0), m_runCache(64*1024),
 	m_lastClickEvent(-1), m_tooltip(0), m_slowStringDrawing(false),
 	m_mouseHidden(false)
 {
@@ -34,6 +37,11 @@ QVimShell::QVimShell(QWidget *parent)
 	connect(timer_firstOff, SIGNAL(timeout()), this, SLOT(startBlinkOffTimer()));
 	connect(timer_cursorBlinkOff, SIGNAL(timeout()), this, SLOT(cursorOff()));
 
+	// Frame pacing
+	m_frameTimer = new QTimer(this);
+	m_frameTimer->setSingleShot(true);
+	connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(flushDamage()));
+
 	// IM Tooltip
 	m_tooltip = new QLabel(this);
 	m_tooltip->setVisible(false);
@@ -49,6 +57,9 @@ QVimShell::QVimShell(QWidget *parent)
 	setAcceptDrops(true);
 	setMouseTracking(true);
 
+	resizeCanvas(size());
+	paintOps.reserve(1024);
+
 	PaintOperation op;
 	op.type = CLEARALL;
 	op.color = background();
@@ -79,22 +90,9 @@ QColor QVimShell::background()
 
 void QVimShell::resizeEvent(QResizeEvent *ev)
 {
-	PaintOperation op;
-	op.type = FILLRECT;
-	op.color = background();
-
-	int dWidth = ev->size().width() - ev->oldSize().width();
-	if (dWidth > 0)
-	{
-		op.rect = QRect(ev->oldSize().width(), 0, dWidth, ev->size().height());
-		queuePaintOp(op);
-	}
-
-	int dHeight = ev->size().height() - ev->oldSize().height();
-	if (dHeight > 0)
-	{
-		op.rect = QRect(0, ev->oldSize().height(), ev->size().width(), dHeight);
-		queuePaintOp(op);
+	resizeCanvas(ev->size());
+	if ( m_glCanvas ) {
+		m_glCanvas->resize(ev->size());
 	}
 
 	//
@@ -196,6 +194,9 @@ void QVimShell::keyPressEvent ( QKeyEvent *ev)
 	char str[20];
 	int len=0;
 
+	// Show the effect of typing without frame pacing delays
+	requestImmediateFrame();
+
 	if ( specialKey( ev, str, &len)) {
 		add_to_input_buf((char_u *) str, len);
 	} else if ( !ev->text().isEmpty() ) {
@@ -276,35 +277,131 @@ QFont QVimShell::fixPainterFont( const QFont& pfont )
 }
 
 /*
- * Slow text painting strategy
+ * Positioned text painting strategy
+ *
+ * Used when the string's cell width does not match its length (wide,
+ * composing or non-BMP characters) or the font is not truly monospace.
+ *
+ * The string is split into clusters (a base character plus any
+ * composing characters) and consecutive clusters that need the same
+ * adjustment to their natural advance to land on the cell grid are
+ * drawn in a single call, using letter spacing to pad each cluster.
+ * Qt applies letter spacing per cluster, so composing characters stay
+ * attached to their base. For a line of CJK text in the same fallback
+ * font this means one call for the whole run.
  *
- * - Paints one character at a time
- * - Looks perfect in any condition
- * - Takes a looong time
- * - FIXME: add support for proper undercurl
+ * FIXME: add support for proper undercurl
  */
-void QVimShell::drawStringSlow( const PaintOperation& op, QPainter &painter )
+void QVimShell::drawStringPositioned( const PaintOperation& op, QPainter &painter )
 {
-	QFont f = op.font;
-	painter.setFont(f);
 	painter.setPen( op.color );
+	QFontMetrics fm = ( op.fontGeneration == m_fontGeneration && op.fontVariant != -1 ) ?
+		fontVariant(op.fontVariant).metrics : QFontMetrics(op.font);
+
+	const QString& str = op.str;
+	int cw = VimWrapper::charWidth();
+	int x = op.pos.x();
+
+	int runStart = 0;
+	int runX = x;
+	int runSpacing = 0;
+	int i = 0;
+
+	// Vim draws composing characters on their own, on top of the
+	// previous cell. Composing glyphs have no advance and hang to
+	// the left of their origin, so place them after that cell.
+	while ( i < str.length() && VimWrapper::charCellWidth(str.at(i)) == 0 &&
+			!str.at(i).isHighSurrogate() ) {
+		i++;
+	}
+	if ( i > 0 ) {
+		painter.setFont(op.font);
+		painter.drawText(QPoint(x + cw, op.pos.y()), str.left(i));
+		runStart = i;
+	}
 
-	QRect rect = op.rect;
-	foreach(QChar c, op.str) {
-		if ( VimWrapper::charCellWidth(c) == 1 ) {
-			rect.setWidth(VimWrapper::charWidth());
-		} else if (VimWrapper::charCellWidth(c) == 2) {
-			rect.setWidth(2*VimWrapper::charWidth());
-		} else {
-			qDebug() << __func__ << "invalid lenght" << c << VimWrapper::charCellWidth(c);
-			continue;
+	while ( i < str.length() ) {
+		// Find the next cluster
+		int start = i;
+		uint ucs = str.at(i).unicode();
+		if ( str.at(i).isHighSurrogate() && i+1 < str.length() &&
+				str.at(i+1).isLowSurrogate() ) {
+			ucs = QChar::surrogateToUcs4(str.at(i), str.at(i+1));
+			i++;
+		}
+		i++;
+		int cells = VimWrapper::charCellWidth(ucs);
+		int advance = (i - start == 1) ? fm.width(str.at(start)) : fm.width(str.mid(start, i - start));
+
+		while ( i < str.length() && VimWrapper::charCellWidth(str.at(i)) == 0 &&
+				!str.at(i).isHighSurrogate() ) {
+			i++;
 		}
 
-		QPoint pos = op.pos;
-		pos.setX(rect.left());
-		painter.drawText(pos, c);
-		rect.moveTo( rect.x() + rect.width(), rect.y() );
+		int spacing = cells*cw - advance;
+		if ( start == runStart ) {
+			runSpacing = spacing;
+		} else if ( spacing != runSpacing ) {
+			// Flush the current run
+			QFont f(op.font);
+			f.setLetterSpacing(QFont::AbsoluteSpacing, runSpacing);
+			painter.setFont(f);
+			painter.drawText(QPoint(runX, op.pos.y()), str.mid(runStart, start - runStart));
+
+			runStart = start;
+			runX = x;
+			runSpacing = spacing;
+		}
+		x += cells*cw;
+	}
+
+	if ( runStart < str.length() ) {
+		QFont f(op.font);
+		f.setLetterSpacing(QFont::AbsoluteSpacing, runSpacing);
+		painter.setFont(f);
+		painter.drawText(QPoint(runX, op.pos.y()), str.mid(runStart));
+	}
+}
+
+/**
+ * Get the shaped layout for the string in a DRAWSTRING op
+ *
+ * Layouts are cached per (string, font variant) and dropped
+ * along with the font variants, so each run of text is only shaped
+ * once. Glyph rasterization itself is already cached by Qt's paint engine.
+ *
+ * Returns NULL if the run cannot be cached.
+ */
+QTextLayout* QVimShell::shapedRun( const PaintOperation& op )
+{
+	if ( op.fontGeneration != m_fontGeneration || op.fontVariant == -1 ) {
+		return NULL;
+	}
+
+	QString key(op.str);
+	key.append(QChar(op.fontVariant));
+
+	QTextLayout *layout = m_runCache.object(key);
+	if ( layout ) {
+		m_paintStats.runCacheHits++;
+		return layout;
+	}
+	m_paintStats.runCacheMisses++;
+
+	layout = new QTextLayout(op.str, op.font);
+	layout->setCacheEnabled(true);
+	QTextOption opt;
+	opt.setWrapMode(QTextOption::NoWrap);
+	layout->setTextOption(opt);
+	layout->beginLayout();
+	layout->createLine().setNumColumns(op.str.length());
+	layout->endLayout();
+
+	// QCache deletes the object if it does not fit
+	if ( !m_runCache.insert(key, layout, key.length()) ) {
+		return NULL;
 	}
+	return layout;
 }
 
 /**
@@ -314,20 +411,89 @@ void QVimShell::drawStringSlow( const PaintOperation& op, QPainter &painter )
 void QVimShell::drawString( const PaintOperation& op, QPainter &painter)
 {
 	painter.setPen( op.color );
-	painter.setFont(op.font);
-	painter.drawText( op.pos, op.str);
+
+	QTextLayout *layout = shapedRun(op);
+	if ( layout ) {
+		// Layouts are positioned by their top left corner, not the baseline
+		QPointF pos(op.pos.x(), op.pos.y() - layout->lineAt(0).ascent());
+		layout->draw(&painter, pos);
+	} else {
+		painter.setFont(op.font);
+		painter.drawText( op.pos, op.str);
+	}
 }
 
-void QVimShell::paintEvent ( QPaintEvent *ev )
+/**
+ * Grow or shrink the backing canvas, preserving its contents
+ *
+ * Any newly exposed area is painted with the background color
+ */
+void QVimShell::resizeCanvas(const QSize& size)
 {
-	QPainter painter(this);
-	while ( !paintOps.isEmpty() ) {
+	if ( size.isEmpty() || size == m_canvas.size() ) {
+		return;
+	}
+
+	QImage canvas(size, QImage::Format_RGB32);
+	canvas.fill(background().rgb());
+
+	if ( !m_canvas.isNull() ) {
+		QPainter painter(&canvas);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.drawImage(0, 0, m_canvas);
+	}
+
+	m_canvas = canvas;
+}
+
+/**
+ * Scroll the canvas area in rect by dy pixels
+ *
+ * Vim only ever scrolls vertically, so this is a plain
+ * scanline copy - no need to go through QPainter.
+ */
+void QVimShell::scrollCanvas(const QRect& rect, int dy)
+{
+	QRect r = rect & m_canvas.rect();
+	if ( r.isEmpty() || dy == 0 || abs(dy) >= r.height() ) {
+		return;
+	}
+
+	int bpp = m_canvas.depth()/8;
+	int offset = r.x()*bpp;
+	int len = r.width()*bpp;
+
+	if ( dy > 0 ) {
+		for ( int y=r.bottom(); y >= r.top() + dy; y-- ) {
+			memcpy(m_canvas.scanLine(y) + offset, m_canvas.scanLine(y-dy) + offset, len);
+		}
+	} else {
+		for ( int y=r.top(); y <= r.bottom() + dy; y++ ) {
+			memcpy(m_canvas.scanLine(y) + offset, m_canvas.scanLine(y-dy) + offset, len);
+		}
+	}
+}
+
+/**
+ * Rasterize all queued paint operations into the backing canvas
+ *
+ * The canvas persists across paint events, the widget itself is
+ * only ever painted by copying the canvas.
+ */
+void QVimShell::flushPaintOps()
+{
+	if ( paintOps.isEmpty() || m_canvas.isNull() ) {
+		return;
+	}
+
+	QPainter painter(&m_canvas);
+	for ( int i=0; i<paintOps.size(); i++ ) {
 		painter.save();
 
-		PaintOperation op = paintOps.dequeue();
+		PaintOperation& op = paintOps[i];
 		switch( op.type ) {
 		case CLEARALL:
-			painter.fillRect(this->rect(), op.color);
+			painter.fillRect(m_canvas.rect(), op.color);
 			break;
 		case FILLRECT:
 			painter.fillRect(op.rect, op.color);
@@ -337,17 +503,15 @@ void QVimShell::paintEvent ( QPaintEvent *ev )
 			painter.drawRect(op.rect);
 			break;
 		case DRAWSTRING:
-			painter.setClipRect(op.rect);
-
-			// Disable underline if undercurl is in place
-			if (op.undercurl && op.font.underline()) {
-				op.font.setUnderline(false);
+			if ( op.bgcolor.isValid() ) {
+				painter.fillRect(op.rect, op.bgcolor);
 			}
+			painter.setClipRect(op.rect);
 
 			if ( m_slowStringDrawing ) {
-				drawStringSlow(op, painter);
+				drawStringPositioned(op, painter);
 			} else if ( op.str.length() != VimWrapper::stringCellWidth(op.str) ) {
-				drawStringSlow(op, painter);
+				drawStringPositioned(op, painter);
 			} else {
 				drawString(op, painter);
 			}
@@ -379,16 +543,16 @@ void QVimShell::paintEvent ( QPaintEvent *ev )
 			painter.restore();
 			painter.end();
 
-			this->scroll(op.pos.x(), op.pos.y(), op.rect);
+			scrollCanvas(op.rect, op.pos.y());
 
-			painter.begin(this);
+			painter.begin(&m_canvas);
 
 			// Repaint exposed background. Vim won't redraw areas exposed by
 			// scroll if it considers them empty because it assumes we already
 			// cleared that area of the screen.
 			QRect rect;
 			rect.setWidth(op.rect.width());
-			rect.setHeight(abs(op.pos.y()));
+			rect.setHeight(qMin(abs(op.pos.y()), op.rect.height()));
 			if (op.pos.y() > 0)
 				rect.moveTopLeft(op.rect.topLeft());
 			else
@@ -400,6 +564,117 @@ void QVimShell::paintEvent ( QPaintEvent *ev )
 
 		painter.restore();
 	}
+
+	// Keeps the reserved capacity around for the next batch
+	paintOps.resize(0);
+}
+
+/**
+ * Copy the dirty region from the canvas into the widget
+ */
+void QVimShell::paintEvent ( QPaintEvent *ev )
+{
+	QElapsedTimer t;
+	t.start();
+
+	flushPaintOps();
+
+	QPainter painter(this);
+	foreach ( const QRect& rect, ev->region().rects() ) {
+		painter.drawImage(rect, m_canvas, rect);
+	}
+
+	framePainted(t.elapsed());
+}
+
+/**
+ * Set the font used to draw text
+ *
+ * Vim switches back and forth between 'guifont' and 'guifontwide',
+ * so the bold/italic/underline variants of every font are built
+ * once and kept until clearFontVariants() is called.
+ */
+void QVimShell::setTextFont(const QFont& f)
+{
+	if ( !m_textFonts.isEmpty() && m_textFonts.at(m_textFont) == f ) {
+		return;
+	}
+
+	int idx = m_textFonts.indexOf(f);
+	if ( idx != -1 ) {
+		m_textFont = idx;
+		return;
+	}
+
+	// Fonts are only ever added, in case 'guifontwide' keeps
+	// changing start over every now and then
+	if ( m_textFonts.size() >= 4 ) {
+		clearFontVariants();
+	}
+
+	m_textFont = m_textFonts.size();
+	m_textFonts.append(f);
+	for ( int style=0; style < StyleCount; style++ ) {
+		QFont variant(f);
+		variant.setBold( style & StyleBold );
+		variant.setItalic( style & StyleItalic );
+		variant.setUnderline( style & StyleUnderline );
+		m_fontVariants.append(FontVariant(variant));
+	}
+}
+
+/**
+ * Drop all font variants, e.g. after 'guifont' changed
+ *
+ * Shaped runs are dropped along with them
+ */
+void QVimShell::clearFontVariants()
+{
+	m_textFonts.clear();
+	m_fontVariants.clear();
+	m_textFont = 0;
+	m_fontGeneration++;
+	m_runCache.clear();
+}
+
+/**
+ * Get the index of a variant of the current text font, style
+ * is a combination of FontStyle flags
+ */
+int QVimShell::textFontVariant(int style)
+{
+	if ( m_textFonts.isEmpty() ) {
+		setTextFont(font());
+	}
+	return m_textFont*StyleCount + style;
+}
+
+/**
+ * Print paint statistics, enabled with the QVIM_PAINT_STATS
+ * environment variable
+ */
+void QVimShell::dumpPaintStats()
+{
+	unsigned long lookups = m_paintStats.runCacheHits + m_paintStats.runCacheMisses;
+	qDebug() << "Shaped run cache:" << m_paintStats.runCacheHits << "hits"
+		<< m_paintStats.runCacheMisses << "misses"
+		<< (lookups ? 100*m_paintStats.runCacheHits/lookups : 0) << "% hit rate";
+	qDebug() << "Paint ops:" << m_paintStats.opsQueued << "queued"
+		<< m_paintStats.opsCollapsed << "collapsed";
+
+	const FrameStats& frames = frameStats();
+	qDebug() << "Frames:" << frames.presented << "presented"
+		<< frames.immediate << "immediate"
+		<< frames.deferred << "deferred"
+		<< (frames.painted ? frames.paintTime/frames.painted : 0) << "ms average paint"
+		<< frames.maxPaintTime << "ms max paint";
+
+	const WaitStats& waits = waitStats();
+	qDebug() << "Timed waits:" << waits.waits << "waits"
+		<< waits.timeouts << "timeouts"
+		<< waits.wakeups << "wakeups without input"
+		<< (waits.timeouts ? waits.overshoot/waits.timeouts : 0) << "ms average overshoot"
+		<< waits.maxOvershoot << "ms max overshoot";
 }
 
 //
@@ -495,14 +770,214 @@ QColor QVimShell::color(const QString& name)
 	return c;
 }
 
+/**
+ * Queue a paint operation for the canvas
+ *
+ * Queued operations that are completely covered by a new opaque
+ * operation are dropped, e.g. clearing a line and then redrawing it
+ * is painted only once. The widget itself is not updated until
+ * flushDamage() is called.
+ *
+ * Scrolls only ever move pixels inside their own rect, which is
+ * how Vim scrolls a single window when the screen is split.
+ */
 void QVimShell::queuePaintOp(PaintOperation op)
 {
-	paintOps.enqueue(op);
-	if ( op.rect.isValid() ) {
-		update(op.rect);
+	op.fontGeneration = m_fontGeneration;
+	m_paintStats.opsQueued++;
+
+	if ( op.type == CLEARALL ) {
+		m_paintStats.opsCollapsed += paintOps.size();
+		paintOps.resize(0);
+	} else if ( op.type == FILLRECT ||
+			(op.type == DRAWSTRING && op.bgcolor.isValid()) ) {
+		// Only look at the tail of the queue, ops are mostly
+		// overwritten right after being queued
+		int stop = qMax(0, paintOps.size() - 32);
+		for ( int i=paintOps.size()-1; i >= stop; i-- ) {
+			const PaintOperation& prev = paintOps.at(i);
+			if ( prev.type == SCROLLRECT && !op.rect.contains(prev.rect) ) {
+				// Content moved, older ops no longer line up. A scroll
+				// that is painted over can go, it only moves pixels
+				// inside its own rect.
+				break;
+			}
+			if ( prev.rect.isValid() && op.rect.contains(prev.rect) ) {
+				paintOps.remove(i);
+				m_paintStats.opsCollapsed++;
+			}
+		}
+	} else if ( op.type == SCROLLRECT && !paintOps.isEmpty() ) {
+		// Consecutive scrolls of the same region in the same direction,
+		// e.g. repeated Ctrl-E in a split, are a single blit
+		PaintOperation& prev = paintOps.last();
+		if ( prev.type == SCROLLRECT && prev.rect == op.rect &&
+				prev.color == op.color &&
+				(prev.pos.y() > 0) == (op.pos.y() > 0) ) {
+			prev.pos.ry() += op.pos.y();
+			m_paintStats.opsCollapsed++;
+			markDirty(op.rect);
+			return;
+		}
+	}
+
+	paintOps.append(op);
+	markDirty( op.rect.isValid() ? op.rect : rect() );
+}
+
+/**
+ * Add a rect to the damaged area
+ *
+ * Damage is tracked as one span per text row
+ */
+void QVimShell::markDirty(const QRect& r)
+{
+	m_dirty = true;
+
+	int rowHeight = qMax(VimWrapper::charHeight(), 1);
+	if ( rowHeight != m_damageRowHeight ) {
+		// Row layout changed, pending spans are meaningless
+		m_damageRowHeight = rowHeight;
+		m_damageAll = true;
+	}
+
+	QRect rect = r & QRect(QPoint(0, 0), size());
+	if ( m_damageAll || rect.isEmpty() ) {
+		return;
+	}
+
+	int last = rect.bottom()/rowHeight;
+	while ( m_damage.size() <= last ) {
+		m_damage.append(qMakePair(QWIDGETSIZE_MAX, -1));
+	}
+
+	for ( int row=rect.top()/rowHeight; row <= last; row++ ) {
+		QPair<int,int>& span = m_damage[row];
+		span.first = qMin(span.first, rect.left());
+		span.second = qMax(span.second, rect.right());
+	}
+}
+
+/**
+ * Present the accumulated damage, paced to the frame interval
+ *
+ * If a frame is not yet due the damage is kept and presented
+ * when the frame timer fires.
+ */
+void QVimShell::requestFrame()
+{
+	if ( !m_dirty ) {
+		return;
+	}
+
+	int delay = frameDelay();
+	if ( delay == 0 ) {
+		flushDamage();
 	} else {
+		frameDeferred();
+		if ( !m_frameTimer->isActive() ) {
+			m_frameTimer->start(delay);
+		}
+	}
+}
+
+/**
+ * Send the accumulated damage to Qt right away, rows with the
+ * same dirty span are merged into a single rect
+ */
+void QVimShell::flushDamage()
+{
+	if ( !m_dirty ) {
+		return;
+	}
+	m_dirty = false;
+	m_frameTimer->stop();
+	framePresented();
+
+	if ( m_damageAll ) {
+		m_damageAll = false;
+		m_damage.resize(0);
+		presentRect(rect());
+		return;
+	}
+
+	QRect pending;
+	for ( int row=0; row<m_damage.size(); row++ ) {
+		QPair<int,int>& span = m_damage[row];
+		if ( span.first > span.second ) {
+			continue;
+		}
+
+		QRect r(span.first, row*m_damageRowHeight,
+				span.second - span.first + 1, m_damageRowHeight);
+		if ( pending.isValid() && pending.left() == r.left() &&
+				pending.right() == r.right() && pending.bottom() + 1 == r.top() ) {
+			pending.setBottom(r.bottom());
+		} else {
+			if ( pending.isValid() ) {
+				presentRect(pending);
+			}
+			pending = r;
+		}
+		span = qMakePair(QWIDGETSIZE_MAX, -1);
+	}
+
+	if ( pending.isValid() ) {
+		presentRect(pending);
+	}
+}
+
+/**
+ * Schedule a repaint of the given canvas area, on whichever
+ * surface is showing the canvas
+ */
+void QVimShell::presentRect(const QRect& rect)
+{
+#ifdef FEAT_GUI_QT_OPENGL
+	if ( m_glCanvas ) {
+		m_glCanvas->updateCanvas(rect);
+		return;
+	}
+#endif
+	update(rect);
+}
+
+/**
+ * Enable/Disable the OpenGL surface
+ *
+ * If OpenGL is not available, or this was built without
+ * QtOpenGL, we keep painting the widget directly.
+ *
+ * Returns false if OpenGL was requested but can't be used.
+ */
+bool QVimShell::setOpenGL(bool enable)
+{
+#ifdef FEAT_GUI_QT_OPENGL
+	if ( enable && !m_glCanvas ) {
+		if ( !GLCanvas::isSupported() ) {
+			return false;
+		}
+
+		m_glCanvas = new GLCanvas(this);
+		if ( !m_glCanvas->isUsable() ) {
+			delete m_glCanvas;
+			m_glCanvas = NULL;
+			return false;
+		}
+
+		m_glCanvas->setGeometry(rect());
+		m_glCanvas->show();
+		m_tooltip->raise();
+		m_glCanvas->updateCanvas(rect());
+	} else if ( !enable && m_glCanvas ) {
+		delete m_glCanvas;
+		m_glCanvas = NULL;
 		update();
 	}
+	return true;
+#else
+	return !enable;
+#endif
 }
 
 void QVimShell::setEncodingUtf8(bool enabled)
@@ -583,6 +1058,7 @@ int QVimShell::charWidth()
 
 void QVimShell::inputMethodEvent(QInputMethodEvent *ev)
 {
+	requestImmediateFrame();
 	if ( !ev->commitString().isEmpty() ) {
 		QByteArray s = VimWrapper::convertTo(ev->commitString());
 		add_to_input_buf_csi( (char_u *) s.data(), s.size() );
@@ -2,11 +2,17 @@
 #define __QVIMSHELL__
 
 #include <QWidget>
-#include <QQueue>
+#include <QVector>
+#include <QPair>
 #include <QLabel>
 #include <QTime>
+#include <QImage>
+#include <QCache>
+#include <QFontMetrics>
+#include <QTextLayout>
 #include "vimwrapper.h"
 
+class GLCanvas;
 
 class QVimShell: public QWidget, public VimWrapper
 {
@@ -20,6 +26,7 @@ public:
 		QRect rect;
 		QColor color;
 		// DRAWSTRING
+		QColor bgcolor; // Invalid for transparent strings
 		QFont font;
 		QString str;
 		bool undercurl;
@@ -28,6 +35,32 @@ public:
 		QPixmap sign;
 		// SCROLL
 		QPoint pos;
+		// Font generation the op was queued with
+		int fontGeneration;
+		// Index of the font variant, or -1
+		int fontVariant;
+	};
+
+	/**
+	 * A text font with some combination of bold, italic and
+	 * underline applied, along with its metrics
+	 */
+	class FontVariant {
+	public:
+		FontVariant(const QFont& f):font(f), metrics(f) {}
+		QFont font;
+		QFontMetrics metrics;
+	};
+	enum FontStyle { StyleBold=1, StyleItalic=2, StyleUnderline=4, StyleCount=8 };
+
+	class PaintStats {
+	public:
+		PaintStats():runCacheHits(0), runCacheMisses(0),
+			opsQueued(0), opsCollapsed(0) {}
+		unsigned long runCacheHits;
+		unsigned long runCacheMisses;
+		unsigned long opsQueued;
+		unsigned long opsCollapsed;
 	};
 
 	QVimShell(QWidget *parent=0);
@@ -36,6 +69,16 @@ public:
 	static QColor color(const QString&);
 
 	void queuePaintOp(PaintOperation);
+	void setTextFont(const QFont&);
+	void clearFontVariants();
+	int textFontVariant(int style);
+	const FontVariant& fontVariant(int idx) const { return m_fontVariants.at(idx); }
+	void flushPaintOps();
+	void requestFrame();
+	const QImage& canvas() const { return m_canvas; }
+	bool setOpenGL(bool);
+	const PaintStats& paintStats() const { return m_paintStats; }
+	void dumpPaintStats();
 
 	QColor background();
 	int charWidth();
@@ -51,6 +94,7 @@ public:
 
 
 public slots:
+	void flushDamage();
 	void setBackground(const QColor);
 	void setCharWidth(int);
 
@@ -79,7 +123,12 @@ protected:
 
 	QFont fixPainterFont(const QFont &);
 	void drawString(const PaintOperation&, QPainter& );
-	void drawStringSlow( const PaintOperation&, QPainter &painter );
+	void drawStringPositioned( const PaintOperation&, QPainter &painter );
+	QTextLayout* shapedRun( const PaintOperation& );
+	void scrollCanvas(const QRect&, int dy);
+	void markDirty(const QRect&);
+	void presentRect(const QRect&);
+	void resizeCanvas(const QSize&);
 
 
 	int_u vimKeyboardModifiers(Qt::KeyboardModifiers);
@@ -118,7 +167,28 @@ private:
 	blink_state blinkState;
 	bool m_encoding_utf8;
 
-	QQueue<PaintOperation> paintOps;
+	QVector<PaintOperation> paintOps;
+	QImage m_canvas;
+
+	// Damage tracking - a dirty [left, right] pixel span for each
+	// text row, sent to Qt as a single update per flush
+	QVector<QPair<int,int> > m_damage;
+	int m_damageRowHeight;
+	bool m_damageAll;
+	bool m_dirty;
+	QTimer *m_frameTimer;
+
+	// Optional OpenGL surface, NULL when painting the widget directly
+	GLCanvas *m_glCanvas;
+
+	// Variants of each text font, StyleCount entries per font
+	// in the same order as m_textFonts
+	QList<QFont> m_textFonts;
+	QList<FontVariant> m_fontVariants;
+	int m_textFont;
+	int m_fontGeneration;
+	QCache<QString, QTextLayout> m_runCache;
+	PaintStats m_paintStats;
 
 	QTime m_lastClick;
 	int m_lastClickEvent;
@@ -1,7 +1,7 @@
 #include <QApplication>
 #include <QStyle>
 #include <QMetaType>
-#include <QTime>
+#include <QTimer>
 #include "vimwrapper.h"
 
 extern "C" {
@@ -11,10 +11,15 @@ extern "C" {
 Q_DECLARE_METATYPE( QList<QUrl> );
 
 VimWrapper::VimWrapper()
-:m_processInputOnly(false)
+:m_processInputOnly(false), m_frameInterval(16), m_immediateFrame(false)
 {
 	qRegisterMetaType<QList<QUrl> >("URLList");
 
+	// Qt does not tell us the display refresh rate, default to 60Hz
+	const char *interval = getenv("QVIM_FRAME_INTERVAL");
+	if ( interval ) {
+		m_frameInterval = qMax(0, atoi(interval));
+	}
 }
 
 /*
@@ -204,7 +209,16 @@ QFont VimWrapper::normalFont()
 
 int VimWrapper::charCellWidth(const QChar& c)
 {
-	int len = utf_char2cells(c.unicode());
+	return charCellWidth((uint)c.unicode());
+}
+
+static int cellWidth(uint ucs)
+{
+	if ( utf_iscomposing(ucs) ) {
+		return 0;
+	}
+
+	int len = utf_char2cells(ucs);
 	if ( len <= 2 ) {
 		return len;
 	}
@@ -212,6 +226,33 @@ int VimWrapper::charCellWidth(const QChar& c)
 	return 0;
 }
 
+/**
+ * Cell width for a unicode code point, composing
+ * characters take no cells of their own
+ *
+ * Widths in the BMP are cached, the cache is dropped
+ * whenever 'ambiwidth' changes.
+ */
+int VimWrapper::charCellWidth(uint ucs)
+{
+	static unsigned char widths[0x10000];
+	static char_u ambw = NUL;
+
+	if ( ucs > 0xffff ) {
+		return cellWidth(ucs);
+	}
+
+	if ( *p_ambw != ambw ) {
+		memset(widths, 0xff, sizeof(widths));
+		ambw = *p_ambw;
+	}
+
+	if ( widths[ucs] == 0xff ) {
+		widths[ucs] = cellWidth(ucs);
+	}
+	return widths[ucs];
+}
+
 int VimWrapper::stringCellWidth(const QString& s)
 {
 	/*
@@ -220,8 +261,14 @@ int VimWrapper::stringCellWidth(const QString& s)
 	 * wide char length.
 	 */
 	int len=0;
-	foreach ( QChar c, s ) {
-		len += charCellWidth(c);
+	for ( int i=0; i<s.length(); i++ ) {
+		uint ucs = s.at(i).unicode();
+		if ( s.at(i).isHighSurrogate() && i+1 < s.length() &&
+				s.at(i+1).isLowSurrogate() ) {
+			ucs = QChar::surrogateToUcs4(s.at(i), s.at(i+1));
+			i++;
+		}
+		len += charCellWidth(ucs);
 	}
 	return len;
 }
@@ -405,15 +452,37 @@ bool VimWrapper::processEvents(long wtime, bool inputOnly)
 	} else if ( wtime == 0 ) {
 		QApplication::processEvents();
 	} else {
-		QTime t;
+		// The deadline timer wakes up the event loop even if no
+		// other event arrives, input events wake it up earlier
+		QElapsedTimer t;
 		t.start();
-		do {
+		QTimer deadline;
+		deadline.setSingleShot(true);
+		m_waitStats.waits++;
+
+		while ( true ) {
+			qint64 remaining = wtime - t.elapsed();
+			if ( remaining <= 0 ) {
+				m_waitStats.timeouts++;
+				m_waitStats.overshoot += -remaining;
+				m_waitStats.maxOvershoot = qMax(m_waitStats.maxOvershoot, -remaining);
+				break;
+			}
+
+			// Timers may fire a bit early, re-arm for the remainder
+			if ( !deadline.isActive() ) {
+				deadline.start(remaining);
+			}
 
 			QApplication::processEvents( QEventLoop::WaitForMoreEvents);
 			if ( hasPendingEvents() || !vim_is_input_buf_empty() ) {
 				goto out;
 			}
-		} while( t.elapsed() < wtime );
+			// Returning for the deadline timer is not a wakeup
+			if ( t.elapsed() < wtime ) {
+				m_waitStats.wakeups++;
+			}
+		}
 	}
 
 out:
@@ -430,3 +499,50 @@ bool VimWrapper::hasPendingEvents()
 	return pendingEvents.size() != 0;
 }
 
+/**
+ * Milliseconds until the next frame can be presented,
+ * 0 if a frame is due now
+ */
+int VimWrapper::frameDelay() const
+{
+	if ( m_immediateFrame || !m_lastFrame.isValid() ) {
+		return 0;
+	}
+
+	qint64 elapsed = m_lastFrame.elapsed();
+	if ( elapsed >= m_frameInterval ) {
+		return 0;
+	}
+	return m_frameInterval - elapsed;
+}
+
+/**
+ * Present the next frame without waiting for the frame interval,
+ * e.g. to show the cursor move right after a keystroke
+ */
+void VimWrapper::requestImmediateFrame()
+{
+	m_immediateFrame = true;
+}
+
+void VimWrapper::framePresented()
+{
+	m_frameStats.presented++;
+	if ( m_immediateFrame ) {
+		m_frameStats.immediate++;
+	}
+	m_immediateFrame = false;
+	m_lastFrame.start();
+}
+
+void VimWrapper::frameDeferred()
+{
+	m_frameStats.deferred++;
+}
+
+void VimWrapper::framePainted(qint64 msecs)
+{
+	m_frameStats.painted++;
+	m_frameStats.paintTime += msecs;
+	m_frameStats.maxPaintTime = qMax(m_frameStats.maxPaintTime, msecs);
+}
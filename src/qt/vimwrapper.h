@@ -6,6 +6,7 @@
 #include <QUrl>
 #include <QWidget>
 #include <QDebug>
+#include <QElapsedTimer>
 
 extern "C" {
 #include "vim.h"
@@ -59,6 +60,7 @@ public:
 
 	static int stringCellWidth(const QString&);
 	static int charCellWidth(const QChar&);
+	static int charCellWidth(uint ucs);
 	static bool isFakeMonospace(QFont );
 
 	/**
@@ -102,13 +104,58 @@ public:
 	void setProcessInputOnly(bool input_only);
 	bool processEvents(long wtime=0, bool inputOnly=false);
 
+	/**
+	 * Frame pacing - damage is presented at most once per
+	 * frame interval, unless an immediate frame was requested
+	 */
+	class FrameStats {
+	public:
+		FrameStats():presented(0), immediate(0), deferred(0),
+			painted(0), paintTime(0), maxPaintTime(0) {}
+		unsigned long presented;
+		unsigned long immediate;
+		unsigned long deferred;
+		unsigned long painted;
+		qint64 paintTime;
+		qint64 maxPaintTime;
+	};
+
+	int frameDelay() const;
+	void requestImmediateFrame();
+	const FrameStats& frameStats() const { return m_frameStats; }
+
+	/**
+	 * Timed waits for input, i.e. processEvents with wtime > 0
+	 */
+	class WaitStats {
+	public:
+		WaitStats():waits(0), timeouts(0), wakeups(0),
+			overshoot(0), maxOvershoot(0) {}
+		unsigned long waits;
+		unsigned long timeouts;
+		unsigned long wakeups; // Woken up before the deadline without input
+		qint64 overshoot;
+		qint64 maxOvershoot;
+	};
+	const WaitStats& waitStats() const { return m_waitStats; }
+
 protected:
 	static QString convertFrom(const char *, int size=-1);
 	bool hasPendingEvents();
 
+	void framePresented();
+	void frameDeferred();
+	void framePainted(qint64 msecs);
+
 private:
 	bool m_processInputOnly;
 	QList<VimEvent *> pendingEvents;
+
+	int m_frameInterval;
+	bool m_immediateFrame;
+	QElapsedTimer m_lastFrame;
+	FrameStats m_frameStats;
+	WaitStats m_waitStats;
 };
 
 #endif
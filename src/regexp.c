@@ -69,12 +69,13 @@
  *
  * Regstart and reganch permit very fast decisions on suitable starting points
  * for a match, cutting down the work a lot.  Regmust permits fast rejection
- * of lines that cannot possibly match.  The regmust tests are costly enough
- * that vim_regcomp() supplies a regmust only if the r.e. contains something
- * potentially expensive (at present, the only such thing detected is * or +
- * at the start of the r.e., which can involve a lot of backup).  Regmlen is
+ * of lines that cannot possibly match.  vim_regcomp() supplies a regmust when
+ * the r.e. starts with something potentially expensive (* or + at the start
+ * of the r.e., which can involve a lot of backup) or when there is a literal
+ * string after the start, which regstart doesn't check.  Regmlen is
  * supplied because the test in vim_regexec() needs it and vim_regcomp() is
- * computing it anyway.
+ * computing it anyway.  The NFA engine finds its regmust in the states, see
+ * nfa_get_regmust().  reg_find_must() is used for both.
  */
 
 /*
@@ -349,6 +350,7 @@ toggle_Magic(x)
 static int re_multi_type __ARGS((int));
 static int cstrncmp __ARGS((char_u *s1, char_u *s2, int *n));
 static char_u *cstrchr __ARGS((char_u *, int));
+static char_u *reg_find_must __ARGS((char_u *s, char_u *must, int mlen));
 
 #ifdef BT_REGEXP_DUMP
 static void	regdump __ARGS((char_u *, bt_regprog_T *));
@@ -1300,6 +1302,29 @@ skip_regexp(startp, dirc, magic, newp)
 static regprog_T  *bt_regcomp __ARGS((char_u *expr, int re_flags));
 static void bt_regfree __ARGS((regprog_T *prog));
 
+static unsigned regcache_state __ARGS((int re_flags));
+static unsigned regcache_hash __ARGS((char_u *expr));
+static regprog_T *regcache_find __ARGS((char_u *expr, unsigned state));
+static regcache_T *regcache_key __ARGS((char_u *expr, unsigned state));
+static int regcache_add __ARGS((regprog_T *prog));
+static void regcache_free_prog __ARGS((regprog_T *prog));
+#if defined(EXITFREE) || defined(PROTO)
+static void regcache_clear __ARGS((void));
+#endif
+#if defined(FEAT_PROFILE) || defined(PROTO)
+typedef struct regtime regtime_T;
+
+static regtime_T *regtime_start __ARGS((regprog_T *prog, proftime_T *pt));
+static void regtime_end __ARGS((regtime_T *rt, proftime_T *pt, int matched));
+static void regtime_clear __ARGS((void));
+static int
+# ifdef __BORLANDC__
+_RTLENTRYF
+# endif
+regtime_compare __ARGS((const void *v1, const void *v2));
+static void regtime_report __ARGS((void));
+#endif
+
 /*
  * bt_regcomp() - compile a regular expression into internal code for the
  * traditional back track matcher.
@@ -1328,6 +1353,7 @@ bt_regcomp(expr, re_flags)
 {
     bt_regprog_T    *r;
     char_u	*scan;
+    char_u	*first;
     char_u	*longest;
     int		len;
     int		flags;
@@ -1432,10 +1458,12 @@ bt_regcomp(expr, re_flags)
 	/*
 	 * When the r.e. starts with BOW, it is faster to look for a regmust
 	 * first. Used a lot for "#" and "*" commands. (Added by mool).
+	 * Otherwise only use the longest string when it is not the first
+	 * item, regstart already checks that one.
 	 */
-	if ((flags & SPSTART || OP(scan) == BOW || OP(scan) == EOW)
-							  && !(flags & HASNL))
+	if (!(flags & HASNL))
 	{
+	    first = scan;
 	    longest = NULL;
 	    len = 0;
 	    for (; scan != NULL; scan = regnext(scan))
@@ -1444,8 +1472,12 @@ bt_regcomp(expr, re_flags)
 		    longest = OPERAND(scan);
 		    len = (int)STRLEN(OPERAND(scan));
 		}
-	    r->regmust = longest;
-	    r->regmlen = len;
+	    if (flags & SPSTART || OP(first) == BOW || OP(first) == EOW
+					       || longest != OPERAND(first))
+	    {
+		r->regmust = longest;
+		r->regmlen = len;
+	    }
 	}
     }
 #ifdef BT_REGEXP_DUMP
@@ -3655,6 +3687,16 @@ typedef struct backpos_S
 static garray_T	regstack = {0, 0, 0, 0, NULL};
 static garray_T	backpos = {0, 0, 0, 0, NULL};
 
+#ifdef FEAT_PROFILE
+static int	regtime_on = FALSE;	/* ":regtime on" was used */
+static hashtab_T regtime_ht;		/* regtime_T entries */
+/* Number of items pushed on "regstack" or NFA states processed and the
+ * largest number of states in an NFA list.  Only counted when measuring,
+ * reset for every call. */
+static long	regtime_steps = 0;
+static long	regtime_peak = 0;
+#endif
+
 /*
  * Both for regstack and backpos tables we use the following strategy of
  * allocation (to reduce malloc/free calls):
@@ -3677,6 +3719,11 @@ free_regexp_stuff()
     ga_clear(&backpos);
     vim_free(reg_tofree);
     vim_free(reg_prev_sub);
+    regcache_clear();
+# ifdef FEAT_PROFILE
+    regtime_on = FALSE;
+    regtime_clear();
+# endif
 }
 #endif
 
@@ -3882,52 +3929,9 @@ bt_regexec_both(line, col, tm)
 #endif
 
     /* If there is a "must appear" string, look for it. */
-    if (prog->regmust != NULL)
-    {
-	int c;
-
-#ifdef FEAT_MBYTE
-	if (has_mbyte)
-	    c = (*mb_ptr2char)(prog->regmust);
-	else
-#endif
-	    c = *prog->regmust;
-	s = line + col;
-
-	/*
-	 * This is used very often, esp. for ":global".  Use three versions of
-	 * the loop to avoid overhead of conditions.
-	 */
-	if (!ireg_ic
-#ifdef FEAT_MBYTE
-		&& !has_mbyte
-#endif
-		)
-	    while ((s = vim_strbyte(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		++s;
-	    }
-#ifdef FEAT_MBYTE
-	else if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
-	    while ((s = vim_strchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-#endif
-	else
-	    while ((s = cstrchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-	if (s == NULL)		/* Not present. */
-	    goto theend;
-    }
+    if (prog->regmust != NULL
+	    && reg_find_must(line + col, prog->regmust, prog->regmlen) == NULL)
+	goto theend;
 
     regline = line;
     reglnum = 0;
@@ -5776,6 +5780,10 @@ regstack_push(state, scan)
     rp->rs_scan = scan;
 
     regstack.ga_len += sizeof(regitem_T);
+#ifdef FEAT_PROFILE
+    if (regtime_on)
+	++regtime_steps;
+#endif
     return rp;
 }
 
@@ -7196,6 +7204,55 @@ cstrchr(s, c)
     return NULL;
 }
 
+/*
+ * Find the "must appear" string "must" of "mlen" bytes in "s", obeying
+ * ireg_ic.  Returns a pointer to where it is found, NULL when it isn't.
+ * This is used very often, esp. for ":global".  Use three versions of the
+ * loop to avoid overhead of conditions.
+ */
+    static char_u *
+reg_find_must(s, must, mlen)
+    char_u	*s;
+    char_u	*must;
+    int		mlen;
+{
+    int		c;
+
+    /* Without ignoring case the bytes can be compared, also in UTF-8,
+     * where the first byte of a character never appears inside another
+     * one.  The library function is much faster on long lines. */
+    if (!ireg_ic
+#ifdef FEAT_MBYTE
+	    && (!has_mbyte || (enc_utf8 && !ireg_icombine))
+#endif
+	    )
+	return (char_u *)strstr((char *)s, (char *)must);
+
+#ifdef FEAT_MBYTE
+    if (has_mbyte)
+	c = (*mb_ptr2char)(must);
+    else
+#endif
+	c = *must;
+#ifdef FEAT_MBYTE
+    if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
+	while ((s = vim_strchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, must, &mlen) == 0)
+		return s;
+	    mb_ptr_adv(s);
+	}
+    else
+#endif
+	while ((s = cstrchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, must, &mlen) == 0)
+		return s;
+	    mb_ptr_adv(s);
+	}
+    return NULL;
+}
+
 /***************************************************************
  *		      regsub stuff			       *
  ***************************************************************/
@@ -7947,10 +8004,431 @@ static char_u regname[][30] = {
 			    };
 #endif
 
+/*
+ * Cache of compiled programs that are not in use.  vim_regfree() puts a
+ * program here instead of freeing it and vim_regcomp() takes it out again
+ * when the same pattern is compiled in the same state.  Each program is used
+ * by only one caller at a time, the matchers keep their state in it.
+ * The entries are ordered by use, the least recently used one first.
+ */
+struct regcache
+{
+    unsigned	rc_state;	/* flags and options used for compiling */
+    unsigned	rc_hash;	/* hash of rc_pattern */
+#ifdef FEAT_SYN_HL
+    int		rc_had_eol;	/* had_eol after compiling */
+#endif
+    int		rc_nocache;	/* "~" or "[:print:]" in the pattern, can't
+				   be cached */
+    char_u	rc_pattern[1];	/* actually longer */
+};
+
+#define REGCACHE_SIZE	64
+
+static regprog_T *regcache_progs[REGCACHE_SIZE];
+static int	regcache_len = 0;
+static int	regcache_off = FALSE;	/* don't add to the cache */
+static long	regcache_hits = 0;
+static long	regcache_misses = 0;
+static long	regcache_evictions = 0;
+
+/*
+ * Return the flags and options that the program compiled for a pattern
+ * depends on, other than the pattern itself.
+ * Must be called after regexp_engine has been set.
+ */
+    static unsigned
+regcache_state(re_flags)
+    int		re_flags;
+{
+    unsigned	state;
+
+    get_cpo_flags();
+    state = (unsigned)re_flags
+	    | ((unsigned)regexp_engine << 4)
+	    | ((unsigned)reg_cpo_lit << 6)
+	    | ((unsigned)reg_cpo_bsl << 7);
+#ifdef FEAT_SYN_HL
+    state |= (unsigned)reg_do_extmatch << 8;
+#endif
+#ifdef FEAT_MBYTE
+    state |= ((unsigned)(has_mbyte != 0) << 10)
+	    | ((unsigned)(enc_utf8 != 0) << 11)
+	    | ((unsigned)(enc_dbcs != 0) << 12);
+#endif
+    return state;
+}
+
+    static unsigned
+regcache_hash(expr)
+    char_u	*expr;
+{
+    unsigned	hash = 0;
+
+    while (*expr != NUL)
+	hash = hash * 31 + *expr++;
+    return hash;
+}
+
+/*
+ * Find a program compiled from "expr" in "state" in the cache.  When found
+ * remove it from the cache and return it, otherwise return NULL.
+ */
+    static regprog_T *
+regcache_find(expr, state)
+    char_u	*expr;
+    unsigned	state;
+{
+    unsigned	hash;
+    regcache_T	*rc;
+    regprog_T	*prog;
+    int		i;
+
+    if (regcache_len <= 0)
+	return NULL;
+    hash = regcache_hash(expr);
+    for (i = regcache_len - 1; i >= 0; --i)
+    {
+	rc = regcache_progs[i]->regcache;
+	if (rc->rc_hash == hash && rc->rc_state == state
+					  && STRCMP(rc->rc_pattern, expr) == 0)
+	{
+	    prog = regcache_progs[i];
+	    --regcache_len;
+	    mch_memmove(regcache_progs + i, regcache_progs + i + 1,
+			     (size_t)(regcache_len - i) * sizeof(regprog_T *));
+#ifdef FEAT_SYN_HL
+	    had_eol = rc->rc_had_eol;
+#endif
+	    ++regcache_hits;
+	    return prog;
+	}
+    }
+    return NULL;
+}
+
+/*
+ * Allocate the cache key for a program just compiled from "expr" in "state".
+ * Returns NULL when out of memory.
+ */
+    static regcache_T *
+regcache_key(expr, state)
+    char_u	*expr;
+    unsigned	state;
+{
+    regcache_T	*rc;
+    size_t	len;
+
+    len = STRLEN(expr);
+    rc = (regcache_T *)alloc((unsigned)(sizeof(regcache_T) + len));
+    if (rc != NULL)
+    {
+	rc->rc_state = state;
+	rc->rc_hash = regcache_hash(expr);
+#ifdef FEAT_SYN_HL
+	rc->rc_had_eol = had_eol;
+#endif
+	/* "~" may stand for the previous substitute string and the
+	 * backtracking engine expands "[:print:]" using 'isprint' when
+	 * compiling.  The key is still used for the pattern text, see
+	 * regtime_start(). */
+	rc->rc_nocache = vim_strchr(expr, '~') != NULL
+			      || strstr((char *)expr, "[:print:]") != NULL;
+	mch_memmove(rc->rc_pattern, expr, len + 1);
+    }
+    return rc;
+}
+
+/*
+ * Add "prog", which is no longer used, to the cache.  When the cache is full
+ * the least recently used program is freed.
+ * Returns FALSE when "prog" can't be cached.
+ */
+    static int
+regcache_add(prog)
+    regprog_T	*prog;
+{
+    if (regcache_off || prog->regcache == NULL || prog->regcache->rc_nocache)
+	return FALSE;
+    if (regcache_len == REGCACHE_SIZE)
+    {
+	regcache_free_prog(regcache_progs[0]);
+	--regcache_len;
+	mch_memmove(regcache_progs, regcache_progs + 1,
+				  (size_t)regcache_len * sizeof(regprog_T *));
+	++regcache_evictions;
+    }
+    /* The DFA states take much memory and are quickly built again. */
+    if (prog->engine == &nfa_regengine)
+	nfa_dfa_free((nfa_regprog_T *)prog);
+    regcache_progs[regcache_len++] = prog;
+    return TRUE;
+}
+
+    static void
+regcache_free_prog(prog)
+    regprog_T	*prog;
+{
+    vim_free(prog->regcache);
+    prog->engine->regfree(prog);
+}
+
+#if defined(EXITFREE) || defined(PROTO)
+/*
+ * Free all cached programs and stop caching.
+ */
+    static void
+regcache_clear()
+{
+    while (regcache_len > 0)
+	regcache_free_prog(regcache_progs[--regcache_len]);
+    regcache_off = TRUE;
+}
+#endif
+
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Add the statistics of the program cache to dictionary "d".
+ */
+    void
+regcache_stats(d)
+    dict_T	*d;
+{
+    dict_add_nr_str(d, "hits", regcache_hits, NULL);
+    dict_add_nr_str(d, "misses", regcache_misses, NULL);
+    dict_add_nr_str(d, "evictions", regcache_evictions, NULL);
+    dict_add_nr_str(d, "entries", (long)regcache_len, NULL);
+}
+#endif
+
+#if defined(FEAT_PROFILE) || defined(PROTO)
+/*
+ * Used for ":regtime": timing of executing a pattern.  The entries are kept
+ * in "regtime_ht" with the pattern as the key, so that the counters are kept
+ * when the program is freed and the same pattern is compiled again.
+ */
+struct regtime
+{
+    proftime_T	rt_total;	/* total time used */
+    proftime_T	rt_slowest;	/* time of slowest call */
+    long	rt_count;	/* nr of times used */
+    long	rt_match;	/* nr of times matched */
+    long	rt_steps;	/* nr of backtracking items or NFA states */
+    long	rt_peak;	/* largest nr of NFA states at one position */
+    int		rt_id;		/* syntax group that used it last or zero */
+    char_u	rt_pattern[1];	/* actually longer */
+};
+
+static regtime_T dumrt;
+#define HIKEY2RT(p)  ((regtime_T *)(p - (dumrt.rt_pattern - (char_u *)&dumrt)))
+#define HI2RT(hi)     HIKEY2RT((hi)->hi_key)
+
+/*
+ * Called before executing "prog" when ":regtime on" was used.  Starts the
+ * timer "pt" and returns the entry to add the counters to, or NULL when the
+ * pattern text is not known.
+ */
+    static regtime_T *
+regtime_start(prog, pt)
+    regprog_T	*prog;
+    proftime_T	*pt;
+{
+    char_u	*pat;
+    hashitem_T	*hi;
+    hash_T	hash;
+    regtime_T	*rt;
+
+    if (prog->regcache == NULL)
+	return NULL;
+    pat = prog->regcache->rc_pattern;
+    hash = hash_hash(pat);
+    hi = hash_lookup(&regtime_ht, pat, hash);
+    if (!HASHITEM_EMPTY(hi))
+	rt = HI2RT(hi);
+    else
+    {
+	rt = (regtime_T *)alloc_clear((unsigned)(sizeof(regtime_T)
+							       + STRLEN(pat)));
+	if (rt == NULL)
+	    return NULL;
+	STRCPY(rt->rt_pattern, pat);
+	if (hash_add_item(&regtime_ht, hi, rt->rt_pattern, hash) == FAIL)
+	{
+	    vim_free(rt);
+	    return NULL;
+	}
+    }
+    if (regtime_id != 0)
+	rt->rt_id = regtime_id;
+    regtime_steps = 0;
+    regtime_peak = 0;
+    profile_start(pt);
+    return rt;
+}
+
+/*
+ * Called after executing a program for which regtime_start() returned "rt".
+ */
+    static void
+regtime_end(rt, pt, matched)
+    regtime_T	*rt;
+    proftime_T	*pt;
+    int		matched;
+{
+    profile_end(pt);
+    profile_add(&rt->rt_total, pt);
+    if (profile_cmp(pt, &rt->rt_slowest) < 0)
+	rt->rt_slowest = *pt;
+    ++rt->rt_count;
+    if (matched)
+	++rt->rt_match;
+    rt->rt_steps += regtime_steps;
+    if (regtime_peak > rt->rt_peak)
+	rt->rt_peak = regtime_peak;
+}
+
+/*
+ * ":regtime".
+ */
+    void
+ex_regtime(eap)
+    exarg_T	*eap;
+{
+    if (STRCMP(eap->arg, "on") == 0)
+    {
+	if (regtime_ht.ht_array == NULL)
+	    hash_init(&regtime_ht);
+	regtime_on = TRUE;
+    }
+    else if (STRCMP(eap->arg, "off") == 0)
+	regtime_on = FALSE;
+    else if (STRCMP(eap->arg, "clear") == 0)
+	regtime_clear();
+    else if (STRCMP(eap->arg, "report") == 0)
+	regtime_report();
+    else
+	EMSG2(_(e_invarg2), eap->arg);
+}
+
+/*
+ * Forget about all the patterns used so far.
+ */
+    static void
+regtime_clear()
+{
+    hash_clear_all(&regtime_ht, (int)(dumrt.rt_pattern - (char_u *)&dumrt));
+    hash_init(&regtime_ht);
+}
+
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+regtime_compare(v1, v2)
+    const void	*v1;
+    const void	*v2;
+{
+    regtime_T	*rt1 = *(regtime_T **)v1;
+    regtime_T	*rt2 = *(regtime_T **)v2;
+    int		r;
+
+    r = profile_cmp(&rt1->rt_total, &rt2->rt_total);
+    if (r == 0)
+	r = STRCMP(rt1->rt_pattern, rt2->rt_pattern);
+    return r;
+}
+
+/*
+ * Show the patterns used since ":regtime on", the slowest one first.
+ */
+    static void
+regtime_report()
+{
+    long	todo;
+    hashitem_T	*hi;
+    regtime_T	*rt;
+    garray_T	ga;
+    int		idx;
+    int		len;
+    proftime_T	total_total;
+    long	total_count = 0;
+
+    ga_init2(&ga, (int)sizeof(regtime_T *), 50);
+    profile_zero(&total_total);
+    todo = (long)regtime_ht.ht_used;
+    for (hi = regtime_ht.ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    rt = HI2RT(hi);
+	    if (rt->rt_count > 0 && ga_grow(&ga, 1) == OK)
+	    {
+		((regtime_T **)ga.ga_data)[ga.ga_len++] = rt;
+		profile_add(&total_total, &rt->rt_total);
+		total_count += rt->rt_count;
+	    }
+	    --todo;
+	}
+
+    /* sort on total time */
+    if (ga.ga_len > 1)
+	qsort(ga.ga_data, (size_t)ga.ga_len, sizeof(regtime_T *),
+							     regtime_compare);
+
+    MSG_PUTS_TITLE(_("  TOTAL      COUNT  MATCH   SLOWEST     STEPS      PEAK   NAME           PATTERN"));
+    MSG_PUTS("\n");
+    for (idx = 0; idx < ga.ga_len && !got_int; ++idx)
+    {
+	rt = ((regtime_T **)ga.ga_data)[idx];
+
+	MSG_PUTS(profile_msg(&rt->rt_total));
+	MSG_PUTS(" "); /* make sure there is always a separating space */
+	msg_advance(13);
+	msg_outnum(rt->rt_count);
+	MSG_PUTS(" ");
+	msg_advance(20);
+	msg_outnum(rt->rt_match);
+	MSG_PUTS(" ");
+	msg_advance(26);
+	MSG_PUTS(profile_msg(&rt->rt_slowest));
+	MSG_PUTS(" ");
+	msg_advance(38);
+	msg_outnum(rt->rt_steps);
+	MSG_PUTS(" ");
+	msg_advance(49);
+	msg_outnum(rt->rt_peak);
+	MSG_PUTS(" ");
+	msg_advance(56);
+	msg_outtrans(syn_id2name(rt->rt_id));
+	MSG_PUTS(" ");
+
+	msg_advance(71);
+	if (Columns < 80)
+	    len = 20; /* will wrap anyway */
+	else
+	    len = Columns - 72;
+	if (len > (int)STRLEN(rt->rt_pattern))
+	    len = (int)STRLEN(rt->rt_pattern);
+	msg_outtrans_len(rt->rt_pattern, len);
+	MSG_PUTS("\n");
+    }
+    ga_clear(&ga);
+    if (!got_int)
+    {
+	MSG_PUTS("\n");
+	MSG_PUTS(profile_msg(&total_total));
+	msg_advance(13);
+	msg_outnum(total_count);
+	MSG_PUTS("\n");
+    }
+}
+
+#endif
+
 /*
  * Compile a regular expression into internal code.
  * Returns the program in allocated memory.
- * Use vim_regfree() to free the memory.
+ * Use vim_regfree() to free the memory.  An unused program compiled earlier
+ * from the same pattern may be returned, see regcache_find().
  * Returns NULL for an error.
  */
     regprog_T *
@@ -7960,6 +8438,7 @@ vim_regcomp(expr_arg, re_flags)
 {
     regprog_T   *prog = NULL;
     char_u	*expr = expr_arg;
+    unsigned	state;
 
     regexp_engine = p_re;
 
@@ -7985,6 +8464,13 @@ vim_regcomp(expr_arg, re_flags)
 	    regexp_engine = AUTOMATIC_ENGINE;
 	}
     }
+
+    state = regcache_state(re_flags);
+    prog = regcache_find(expr_arg, state);
+    if (prog != NULL)
+	return prog;
+    ++regcache_misses;
+
 #ifdef DEBUG
     bt_regengine.expr = expr;
     nfa_regengine.expr = expr;
@@ -8023,19 +8509,26 @@ vim_regcomp(expr_arg, re_flags)
 	if (regexp_engine == AUTOMATIC_ENGINE)
 	    prog = bt_regengine.regcomp(expr, re_flags);
     }
+    else if (regexp_engine == AUTOMATIC_ENGINE)
+	/* The DFA is only used when the engine was not explicitly selected,
+	 * so that 're' set to 2 keeps using the plain NFA. */
+	nfa_dfa_enable((nfa_regprog_T *)prog);
 
+    if (prog != NULL)
+	prog->regcache = regcache_key(expr_arg, state);
     return prog;
 }
 
 /*
  * Free a compiled regexp program, returned by vim_regcomp().
+ * The program may be kept in the cache, it must not be used after this.
  */
     void
 vim_regfree(prog)
     regprog_T   *prog;
 {
-    if (prog != NULL)
-	prog->engine->regfree(prog);
+    if (prog != NULL && !regcache_add(prog))
+	regcache_free_prog(prog);
 }
 
 /*
@@ -8051,6 +8544,18 @@ vim_regexec(rmp, line, col)
     char_u      *line;  /* string to match against */
     colnr_T     col;    /* column to start looking for match */
 {
+#ifdef FEAT_PROFILE
+    regtime_T	*rt;
+    proftime_T	pt;
+    int		r;
+
+    if (regtime_on && (rt = regtime_start(rmp->regprog, &pt)) != NULL)
+    {
+	r = rmp->regprog->engine->regexec(rmp, line, col);
+	regtime_end(rt, &pt, r);
+	return r;
+    }
+#endif
     return rmp->regprog->engine->regexec(rmp, line, col);
 }
 
@@ -8065,6 +8570,18 @@ vim_regexec_nl(rmp, line, col)
     char_u *line;
     colnr_T col;
 {
+# ifdef FEAT_PROFILE
+    regtime_T	*rt;
+    proftime_T	pt;
+    int		r;
+
+    if (regtime_on && (rt = regtime_start(rmp->regprog, &pt)) != NULL)
+    {
+	r = rmp->regprog->engine->regexec_nl(rmp, line, col);
+	regtime_end(rt, &pt, r);
+	return r;
+    }
+# endif
     return rmp->regprog->engine->regexec_nl(rmp, line, col);
 }
 #endif
@@ -8086,5 +8603,53 @@ vim_regexec_multi(rmp, win, buf, lnum, col, tm)
     colnr_T     col;            /* column to start looking for match */
     proftime_T	*tm;		/* timeout limit or NULL */
 {
+#ifdef FEAT_PROFILE
+    regtime_T	*rt;
+    proftime_T	pt;
+    long	r;
+
+    if (regtime_on && (rt = regtime_start(rmp->regprog, &pt)) != NULL)
+    {
+	r = rmp->regprog->engine->regexec_multi(rmp, win, buf, lnum, col, tm);
+	regtime_end(rt, &pt, r > 0);
+	return r;
+    }
+#endif
     return rmp->regprog->engine->regexec_multi(rmp, win, buf, lnum, col, tm);
 }
+
+/*
+ * Return the text that every match of "rmp" must contain, so that the caller
+ * can skip over lines without it: vim_regexec_multi() never finds a match in
+ * such a line, because it rejects it by comparing bytes.  "*lenp" is set to
+ * the length.
+ * Returns NULL when there is no such text or case is ignored.
+ */
+    char_u *
+vim_regmust(rmp, lenp)
+    regmmatch_T	*rmp;
+    int		*lenp;
+{
+    regprog_T	*prog = rmp->regprog;
+    int		ic = rmp->rmm_ic;
+
+    if (prog->regflags & RF_ICASE)
+	ic = TRUE;
+    else if (prog->regflags & RF_NOICASE)
+	ic = FALSE;
+    if (ic)
+	return NULL;
+#ifdef FEAT_MBYTE
+    /* Same condition as where reg_find_must() uses strstr(). */
+    if ((prog->regflags & RF_ICOMBINE) || (has_mbyte && !enc_utf8))
+	return NULL;
+#endif
+
+    if (prog->engine == &nfa_regengine)
+    {
+	*lenp = ((nfa_regprog_T *)prog)->regmlen;
+	return ((nfa_regprog_T *)prog)->regmust;
+    }
+    *lenp = ((bt_regprog_T *)prog)->regmlen;
+    return ((bt_regprog_T *)prog)->regmust;
+}
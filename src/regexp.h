@@ -28,6 +28,7 @@
 #define NFA_MAX_BRACES 20
 
 typedef struct regengine regengine_T;
+typedef struct regcache regcache_T;
 
 /*
  * Structure returned by vim_regcomp() to pass on to vim_regexec().
@@ -38,6 +39,7 @@ typedef struct regprog
 {
     regengine_T		*engine;
     unsigned		regflags;
+    regcache_T		*regcache;	/* key in the program cache or NULL */
 } regprog_T;
 
 /*
@@ -47,9 +49,10 @@ typedef struct regprog
  */
 typedef struct
 {
-    /* These two members implement regprog_T */
+    /* These three members implement regprog_T */
     regengine_T		*engine;
     unsigned		regflags;
+    regcache_T		*regcache;
 
     int			regstart;
     char_u		reganch;
@@ -76,20 +79,28 @@ struct nfa_state
     int			val;
 };
 
+/* Lazily built DFA for the NFA matcher, defined in regexp_nfa.c. */
+typedef struct nfa_dfa nfa_dfa_T;
+
 /*
  * Structure used by the NFA matcher.
  */
 typedef struct
 {
-    /* These two members implement regprog_T */
+    /* These three members implement regprog_T */
     regengine_T		*engine;
     unsigned		regflags;
+    regcache_T		*regcache;
 
     nfa_state_T		*start;		/* points into state[] */
 
     int			reganch;	/* pattern starts with ^ */
     int			regstart;	/* char at start of pattern */
     char_u		*match_text;	/* plain text to match with */
+    char_u		*regmust;	/* text that must appear or NULL */
+    int			regmlen;	/* length of regmust */
+    int			dfa_ok;		/* can use "dfa" to check a line */
+    nfa_dfa_T		*dfa;		/* states built so far or NULL */
 
     int			has_zend;	/* pattern contains \ze */
     int			has_backref;	/* pattern contains \1 .. \9 */
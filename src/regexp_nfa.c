@@ -276,10 +276,54 @@ static int nfa_alt_listid;
 /* 0 for first call to nfa_regmatch(), 1 for recursive call. */
 static int nfa_ll_index = 0;
 
+/*
+ * A DFA that is built lazily while matching.  It is used to quickly find out
+ * that there is no match in the rest of a line, without running the NFA
+ * simulation; when there may be a match the NFA is used to find where it is
+ * and what the submatches are.  Each DFA state stands for the set of NFA
+ * states that can be active at a position.  Only patterns that consist of
+ * characters, option independent character classes, collections, "^" and "$"
+ * are handled, see nfa_dfa_enable().
+ */
+#define NFA_DFA_MAX_STATES  100	    /* flush all states when there are more */
+#define NFA_DFA_MAX_TOTAL   1000    /* same for the states of all programs */
+#define NFA_DFA_HASH_SIZE   64	    /* must be a power of two */
+
+typedef struct nfa_dstate nfa_dstate_T;
+struct nfa_dstate
+{
+    nfa_dstate_T    *ds_hnext;	    /* next state in the same hash bucket */
+    nfa_dstate_T    *ds_next[128];  /* next state for an ASCII char or NULL */
+    unsigned	    ds_hash;
+    int		    ds_match;	    /* contains NFA_MATCH */
+    int		    ds_eol;	    /* can match at end of line, -1: unknown */
+    int		    ds_count;	    /* number of entries in ds_states[] */
+    int		    ds_states[1];   /* NFA state indexes, actually longer */
+};
+
+struct nfa_dfa
+{
+    int		    dfa_ic;	    /* value of ireg_ic used for the states */
+    int		    dfa_count;	    /* number of DFA states */
+    int		    dfa_flushed;    /* set when the states were flushed */
+    nfa_dstate_T    *dfa_start[2];  /* start state, [1] at start of line */
+    nfa_dstate_T    *dfa_hash[NFA_DFA_HASH_SIZE];
+    int		    dfa_gen;	    /* dfa_mark[] value for the current set */
+    int		    *dfa_mark;	    /* for each NFA state */
+    int		    *dfa_work;	    /* NFA states of the set being built */
+    int		    dfa_nwork;
+    nfa_state_T	    **dfa_stack;    /* used by nfa_dfa_closure() */
+};
+
+/* Number of DFA states of all programs, each takes more than 1 Kbyte. */
+static int nfa_dfa_total = 0;
+
 static int nfa_regcomp_start __ARGS((char_u *expr, int re_flags));
 static int nfa_get_reganch __ARGS((nfa_state_T *start, int depth));
 static int nfa_get_regstart __ARGS((nfa_state_T *start, int depth));
 static char_u *nfa_get_match_text __ARGS((nfa_state_T *start));
+static int nfa_match_reachable __ARGS((nfa_regprog_T *prog, nfa_state_T *avoid, char_u *visited, nfa_state_T **stack));
+static void nfa_get_regmust __ARGS((nfa_regprog_T *prog));
 static int realloc_post_list __ARGS((void));
 static int nfa_recognize_char_class __ARGS((char_u *start, char_u *end, int extra_newl));
 static int nfa_emit_equi_class __ARGS((int c));
@@ -302,10 +346,27 @@ static int nfa_max_width __ARGS((nfa_state_T *startstate, int depth));
 static nfa_state_T *post2nfa __ARGS((int *postfix, int *end, int nfa_calc_size));
 static void nfa_postprocess __ARGS((nfa_regprog_T *prog));
 static int check_char_class __ARGS((int class, int c));
+static int nfa_coll_match __ARGS((nfa_state_T *start, int curc));
+static int nfa_class_match __ARGS((int class, int curc));
 static void nfa_save_listids __ARGS((nfa_regprog_T *prog, int *list));
 static void nfa_restore_listids __ARGS((nfa_regprog_T *prog, int *list));
 static int nfa_re_num_cmp __ARGS((long_u val, int op, long_u pos));
 static long nfa_regtry __ARGS((nfa_regprog_T *prog, colnr_T col));
+static void nfa_dfa_enable __ARGS((nfa_regprog_T *prog));
+static void nfa_dfa_flush __ARGS((nfa_dfa_T *dfa));
+static void nfa_dfa_free __ARGS((nfa_regprog_T *prog));
+static void nfa_dfa_new_set __ARGS((nfa_regprog_T *prog));
+static void nfa_dfa_closure __ARGS((nfa_regprog_T *prog, nfa_state_T *start, int bol, int eol));
+static int nfa_dfa_char_match __ARGS((nfa_state_T *state, int curc, int clen));
+static int
+# ifdef __BORLANDC__
+    _RTLENTRYF
+# endif
+	nfa_dfa_compare __ARGS((const void *s1, const void *s2));
+static nfa_dstate_T *nfa_dfa_find_state __ARGS((nfa_regprog_T *prog));
+static nfa_dstate_T *nfa_dfa_step __ARGS((nfa_regprog_T *prog, nfa_dstate_T *ds, int curc, int clen));
+static int nfa_dfa_eol_match __ARGS((nfa_regprog_T *prog, nfa_dstate_T *ds, int bol));
+static int nfa_dfa_may_match __ARGS((nfa_regprog_T *prog, char_u *line, colnr_T col));
 static long nfa_regexec_both __ARGS((char_u *line, colnr_T col));
 static regprog_T *nfa_regcomp __ARGS((char_u *expr, int re_flags));
 static void nfa_regfree __ARGS((regprog_T *prog));
@@ -554,6 +615,133 @@ nfa_get_match_text(start)
     return ret;
 }
 
+/*
+ * Return TRUE when the NFA_MATCH state of "prog" can be reached from the
+ * start without going through state "avoid".  Follows both "out" and "out1"
+ * of every state, which includes all the ways the matcher can go, and more.
+ * "visited" and "stack" have room for prog->nstate entries.
+ */
+    static int
+nfa_match_reachable(prog, avoid, visited, stack)
+    nfa_regprog_T	*prog;
+    nfa_state_T		*avoid;
+    char_u		*visited;
+    nfa_state_T		**stack;
+{
+    nfa_state_T	*p;
+    nfa_state_T	*next[2];
+    int		depth = 0;
+    int		i;
+
+    vim_memset(visited, 0, (size_t)prog->nstate);
+    stack[depth++] = prog->start;
+    visited[prog->start - prog->state] = TRUE;
+    while (depth > 0)
+    {
+	p = stack[--depth];
+	if (p->c == NFA_MATCH)
+	    return TRUE;
+	next[0] = p->out;
+	next[1] = p->out1;
+	for (i = 0; i < 2; ++i)
+	    if (next[i] != NULL && next[i] != avoid
+					    && !visited[next[i] - prog->state])
+	    {
+		visited[next[i] - prog->state] = TRUE;
+		stack[depth++] = next[i];
+	    }
+    }
+    return FALSE;
+}
+
+#define NFA_MUST_MAX_STATES	1000	/* don't analyze bigger programs */
+#define NFA_MUST_MAX_TRIES	20	/* number of candidates to check */
+
+/*
+ * Find the longest sequence of characters that every match of "prog" must
+ * contain and set prog->regmust to it.  A character state that can't be
+ * avoided on the way to NFA_MATCH is followed by the characters it leads to,
+ * those are matched in one piece.  Not done when a match may continue in
+ * the next line, the text is only looked for in the first line.
+ */
+    static void
+nfa_get_regmust(prog)
+    nfa_regprog_T	*prog;
+{
+    int		n = prog->nstate;
+    int		*runlen;
+    char_u	*visited;
+    nfa_state_T	**stack;
+    nfa_state_T	*p;
+    int		best;
+    int		tries;
+    int		len;
+    int		i;
+    char_u	*s;
+
+    prog->regmust = NULL;
+    prog->regmlen = 0;
+    if (prog->match_text != NULL || n > NFA_MUST_MAX_STATES)
+	return;
+    for (i = 0; i < n; ++i)
+	if (prog->state[i].c == NFA_NEWL || (prog->state[i].c >= NFA_FIRST_NL
+					&& prog->state[i].c <= NFA_LAST_NL))
+	    return;
+
+    runlen = (int *)lalloc((long_u)(n * sizeof(int)), FALSE);
+    visited = alloc((unsigned)n);
+    stack = (nfa_state_T **)lalloc((long_u)(n * sizeof(nfa_state_T *)),
+									FALSE);
+    if (runlen == NULL || visited == NULL || stack == NULL)
+	goto theend;
+
+    /* Number of bytes in the sequence of characters starting at each
+     * state. */
+    for (i = 0; i < n; ++i)
+    {
+	len = 0;
+	for (p = &prog->state[i]; p != NULL && p->c > 0; p = p->out)
+	    len += MB_CHAR2LEN(p->c);
+	runlen[i] = len;
+    }
+
+    /* Try the longest sequences first, on a tie the later one. */
+    for (tries = 0; tries < NFA_MUST_MAX_TRIES; ++tries)
+    {
+	best = -1;
+	for (i = 0; i < n; ++i)
+	    if (runlen[i] > 0 && (best < 0 || runlen[i] >= runlen[best]))
+		best = i;
+	if (best < 0)
+	    break;
+	if (!nfa_match_reachable(prog, &prog->state[best], visited, stack))
+	{
+	    prog->regmust = alloc(runlen[best] + 1);
+	    if (prog->regmust == NULL)
+		break;
+	    s = prog->regmust;
+	    for (p = &prog->state[best]; p != NULL && p->c > 0; p = p->out)
+	    {
+#ifdef FEAT_MBYTE
+		if (has_mbyte)
+		    s += (*mb_char2bytes)(p->c, s);
+		else
+#endif
+		    *s++ = p->c;
+	    }
+	    *s = NUL;
+	    prog->regmlen = runlen[best];
+	    break;
+	}
+	runlen[best] = 0;
+    }
+
+theend:
+    vim_free(runlen);
+    vim_free(visited);
+    vim_free(stack);
+}
+
 /*
  * Allocate more space for post_start.  Called when
  * running above the estimated number of states.
@@ -4446,6 +4634,119 @@ check_char_class(class, c)
     return FAIL;
 }
 
+/*
+ * Check character "curc" against the collection that starts with "start",
+ * which is an NFA_START_COLL or NFA_START_NEG_COLL state.
+ * Return TRUE if the collection matches.
+ */
+    static int
+nfa_coll_match(start, curc)
+    nfa_state_T	*start;
+    int		curc;
+{
+    /* What follows is a list of characters, until NFA_END_COLL.
+     * One of them must match or none of them must match. */
+    nfa_state_T	*state;
+    int		result_if_matched;
+    int		c1, c2;
+
+    state = start->out;
+    result_if_matched = (start->c == NFA_START_COLL);
+    for (;;)
+    {
+	if (state->c == NFA_END_COLL)
+	    return !result_if_matched;
+	if (state->c == NFA_RANGE_MIN)
+	{
+	    c1 = state->val;
+	    state = state->out; /* advance to NFA_RANGE_MAX */
+	    c2 = state->val;
+#ifdef ENABLE_LOG
+	    fprintf(log_fd, "NFA_RANGE_MIN curc=%d c1=%d c2=%d\n",
+		    curc, c1, c2);
+#endif
+	    if (curc >= c1 && curc <= c2)
+		return result_if_matched;
+	    if (ireg_ic)
+	    {
+		int curc_low = MB_TOLOWER(curc);
+
+		for ( ; c1 <= c2; ++c1)
+		    if (MB_TOLOWER(c1) == curc_low)
+			return result_if_matched;
+	    }
+	}
+	else if (state->c < 0 ? check_char_class(state->c, curc)
+		    : (curc == state->c
+		       || (ireg_ic && MB_TOLOWER(curc)
+						== MB_TOLOWER(state->c))))
+	    return result_if_matched;
+	state = state->out;
+    }
+}
+
+/*
+ * Check character "curc" against the character class "class", one of
+ * NFA_WHITE to NFA_NUPPER_IC.  These do not depend on options.
+ * Return TRUE if it matches, FALSE if not or for any other state.
+ */
+    static int
+nfa_class_match(class, curc)
+    int		class;
+    int		curc;
+{
+    switch (class)
+    {
+	case NFA_WHITE:		/*  \s	*/
+	    return vim_iswhite(curc);
+	case NFA_NWHITE:	/*  \S	*/
+	    return curc != NUL && !vim_iswhite(curc);
+	case NFA_DIGIT:		/*  \d	*/
+	    return ri_digit(curc);
+	case NFA_NDIGIT:	/*  \D	*/
+	    return curc != NUL && !ri_digit(curc);
+	case NFA_HEX:		/*  \x	*/
+	    return ri_hex(curc);
+	case NFA_NHEX:		/*  \X	*/
+	    return curc != NUL && !ri_hex(curc);
+	case NFA_OCTAL:		/*  \o	*/
+	    return ri_octal(curc);
+	case NFA_NOCTAL:	/*  \O	*/
+	    return curc != NUL && !ri_octal(curc);
+	case NFA_WORD:		/*  \w	*/
+	    return ri_word(curc);
+	case NFA_NWORD:		/*  \W	*/
+	    return curc != NUL && !ri_word(curc);
+	case NFA_HEAD:		/*  \h	*/
+	    return ri_head(curc);
+	case NFA_NHEAD:		/*  \H	*/
+	    return curc != NUL && !ri_head(curc);
+	case NFA_ALPHA:		/*  \a	*/
+	    return ri_alpha(curc);
+	case NFA_NALPHA:	/*  \A	*/
+	    return curc != NUL && !ri_alpha(curc);
+	case NFA_LOWER:		/*  \l	*/
+	    return ri_lower(curc);
+	case NFA_NLOWER:	/*  \L	*/
+	    return curc != NUL && !ri_lower(curc);
+	case NFA_UPPER:		/*  \u	*/
+	    return ri_upper(curc);
+	case NFA_NUPPER:	/*  \U	*/
+	    return curc != NUL && !ri_upper(curc);
+	case NFA_LOWER_IC:	/* [a-z] */
+	    return ri_lower(curc) || (ireg_ic && ri_upper(curc));
+	case NFA_NLOWER_IC:	/* [^a-z] */
+	    return curc != NUL
+			  && !(ri_lower(curc) || (ireg_ic && ri_upper(curc)));
+	case NFA_UPPER_IC:	/* [A-Z] */
+	    return ri_upper(curc) || (ireg_ic && ri_lower(curc));
+	case NFA_NUPPER_IC:	/* ^[A-Z] */
+	    return curc != NUL
+			  && !(ri_upper(curc) || (ireg_ic && ri_lower(curc)));
+    }
+    return FALSE;
+}
+
 /*
  * Check for a match with subexpression "subidx".
  * Return TRUE if it matches.
@@ -5191,6 +5492,14 @@ nfa_regmatch(prog, start, submatch, m)
 	 */
 	if (thislist->n == 0)
 	    break;
+#ifdef FEAT_PROFILE
+	if (regtime_on)
+	{
+	    regtime_steps += thislist->n;
+	    if (thislist->n > regtime_peak)
+		regtime_peak = thislist->n;
+	}
+#endif
 
 	/* compute nextlist */
 	for (listidx = 0; listidx < thislist->n; ++listidx)
@@ -5679,68 +5988,9 @@ nfa_regmatch(prog, start, submatch, m)
 
 	    case NFA_START_COLL:
 	    case NFA_START_NEG_COLL:
-	      {
-		/* What follows is a list of characters, until NFA_END_COLL.
-		 * One of them must match or none of them must match. */
-		nfa_state_T	*state;
-		int		result_if_matched;
-		int		c1, c2;
-
 		/* Never match EOL. If it's part of the collection it is added
 		 * as a separate state with an OR. */
-		if (curc == NUL)
-		    break;
-
-		state = t->state->out;
-		result_if_matched = (t->state->c == NFA_START_COLL);
-		for (;;)
-		{
-		    if (state->c == NFA_END_COLL)
-		    {
-			result = !result_if_matched;
-			break;
-		    }
-		    if (state->c == NFA_RANGE_MIN)
-		    {
-			c1 = state->val;
-			state = state->out; /* advance to NFA_RANGE_MAX */
-			c2 = state->val;
-#ifdef ENABLE_LOG
-			fprintf(log_fd, "NFA_RANGE_MIN curc=%d c1=%d c2=%d\n",
-				curc, c1, c2);
-#endif
-			if (curc >= c1 && curc <= c2)
-			{
-			    result = result_if_matched;
-			    break;
-			}
-			if (ireg_ic)
-			{
-			    int curc_low = MB_TOLOWER(curc);
-			    int done = FALSE;
-
-			    for ( ; c1 <= c2; ++c1)
-				if (MB_TOLOWER(c1) == curc_low)
-				{
-				    result = result_if_matched;
-				    done = TRUE;
-				    break;
-				}
-			    if (done)
-				break;
-			}
-		    }
-		    else if (state->c < 0 ? check_char_class(state->c, curc)
-			        : (curc == state->c
-				   || (ireg_ic && MB_TOLOWER(curc)
-						    == MB_TOLOWER(state->c))))
-		    {
-			result = result_if_matched;
-			break;
-		    }
-		    state = state->out;
-		}
-		if (result)
+		if (curc != NUL && nfa_coll_match(t->state, curc))
 		{
 		    /* next state is in out of the NFA_END_COLL, out1 of
 		     * START points to the END state */
@@ -5748,7 +5998,6 @@ nfa_regmatch(prog, start, submatch, m)
 		    add_off = clen;
 		}
 		break;
-	      }
 
 	    case NFA_ANY:
 		/* Any char except '\0', (end of input) does not match. */
@@ -5804,114 +6053,28 @@ nfa_regmatch(prog, start, submatch, m)
 		break;
 
 	    case NFA_WHITE:	/*  \s	*/
-		result = vim_iswhite(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NWHITE:	/*  \S	*/
-		result = curc != NUL && !vim_iswhite(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_DIGIT:	/*  \d	*/
-		result = ri_digit(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NDIGIT:	/*  \D	*/
-		result = curc != NUL && !ri_digit(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_HEX:	/*  \x	*/
-		result = ri_hex(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NHEX:	/*  \X	*/
-		result = curc != NUL && !ri_hex(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_OCTAL:	/*  \o	*/
-		result = ri_octal(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NOCTAL:	/*  \O	*/
-		result = curc != NUL && !ri_octal(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_WORD:	/*  \w	*/
-		result = ri_word(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NWORD:	/*  \W	*/
-		result = curc != NUL && !ri_word(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_HEAD:	/*  \h	*/
-		result = ri_head(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NHEAD:	/*  \H	*/
-		result = curc != NUL && !ri_head(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_ALPHA:	/*  \a	*/
-		result = ri_alpha(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NALPHA:	/*  \A	*/
-		result = curc != NUL && !ri_alpha(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_LOWER:	/*  \l	*/
-		result = ri_lower(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NLOWER:	/*  \L	*/
-		result = curc != NUL && !ri_lower(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_UPPER:	/*  \u	*/
-		result = ri_upper(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NUPPER:	/* \U	*/
-		result = curc != NUL && !ri_upper(curc);
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_LOWER_IC:	/* [a-z] */
-		result = ri_lower(curc) || (ireg_ic && ri_upper(curc));
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NLOWER_IC:	/* [^a-z] */
-		result = curc != NUL
-			  && !(ri_lower(curc) || (ireg_ic && ri_upper(curc)));
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_UPPER_IC:	/* [A-Z] */
-		result = ri_upper(curc) || (ireg_ic && ri_lower(curc));
-		ADD_STATE_IF_MATCH(t->state);
-		break;
-
 	    case NFA_NUPPER_IC:	/* ^[A-Z] */
-		result = curc != NUL
-			  && !(ri_upper(curc) || (ireg_ic && ri_lower(curc)));
+		result = nfa_class_match(t->state->c, curc);
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
@@ -6468,6 +6631,472 @@ nfa_regtry(prog, col)
     return 1 + reglnum;
 }
 
+/*
+ * Set "prog->dfa_ok" when the DFA can be used for "prog".
+ */
+    static void
+nfa_dfa_enable(prog)
+    nfa_regprog_T   *prog;
+{
+    int		i;
+    int		c;
+
+    /* Plain text is found quicker with find_match_text(). */
+    if (prog->match_text != NULL)
+	return;
+
+    for (i = 0; i < prog->nstate; ++i)
+    {
+	c = prog->state[i].c;
+	if (c > 0 || (c >= NFA_MOPEN && c <= NFA_MCLOSE9)
+#ifdef FEAT_SYN_HL
+		|| (c >= NFA_ZOPEN && c <= NFA_ZCLOSE9)
+#endif
+		|| (c >= NFA_WHITE && c <= NFA_NUPPER_IC)
+		|| (c >= NFA_CLASS_ALNUM && c <= NFA_CLASS_ESCAPE
+						   && c != NFA_CLASS_PRINT))
+	    continue;
+	switch (c)
+	{
+	    case NFA_SPLIT:
+	    case NFA_MATCH:
+	    case NFA_SKIP_CHAR:
+	    case NFA_START_COLL:
+	    case NFA_END_COLL:
+	    case NFA_START_NEG_COLL:
+	    case NFA_END_NEG_COLL:
+	    case NFA_RANGE_MIN:
+	    case NFA_RANGE_MAX:
+	    case NFA_BOL:
+	    case NFA_EOL:
+	    case NFA_ZSTART:
+	    case NFA_ZEND:
+	    case NFA_NOPEN:
+	    case NFA_NCLOSE:
+	    case NFA_ANY:
+		break;
+
+	    default:
+		/* Anything else, such as "\n", "\<", "\k" and "[:print:]",
+		 * depends on more than the current character or on option
+		 * values. */
+		return;
+	}
+    }
+    prog->dfa_ok = TRUE;
+}
+
+/*
+ * Free all the DFA states of "dfa".
+ */
+    static void
+nfa_dfa_flush(dfa)
+    nfa_dfa_T	*dfa;
+{
+    int		    i;
+    nfa_dstate_T    *ds;
+
+    for (i = 0; i < NFA_DFA_HASH_SIZE; ++i)
+	while (dfa->dfa_hash[i] != NULL)
+	{
+	    ds = dfa->dfa_hash[i];
+	    dfa->dfa_hash[i] = ds->ds_hnext;
+	    vim_free(ds);
+	}
+    dfa->dfa_start[0] = NULL;
+    dfa->dfa_start[1] = NULL;
+    nfa_dfa_total -= dfa->dfa_count;
+    dfa->dfa_count = 0;
+    dfa->dfa_flushed = TRUE;
+}
+
+/*
+ * Free the DFA of "prog".
+ */
+    static void
+nfa_dfa_free(prog)
+    nfa_regprog_T   *prog;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+
+    if (dfa != NULL)
+    {
+	nfa_dfa_flush(dfa);
+	vim_free(dfa->dfa_mark);
+	vim_free(dfa->dfa_work);
+	vim_free(dfa->dfa_stack);
+	vim_free(dfa);
+	prog->dfa = NULL;
+    }
+}
+
+/*
+ * Start building a new set of NFA states.
+ */
+    static void
+nfa_dfa_new_set(prog)
+    nfa_regprog_T   *prog;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+
+    if (++dfa->dfa_gen <= 0)
+    {
+	vim_memset(dfa->dfa_mark, 0, prog->nstate * sizeof(int));
+	dfa->dfa_gen = 1;
+    }
+    dfa->dfa_nwork = 0;
+}
+
+/*
+ * Add to the set being built the NFA states that can be reached from "start"
+ * without consuming a character.  "bol" is TRUE at the start of the line,
+ * "eol" at the end of the line.  Without "eol" an NFA_EOL state is added to
+ * the set, it is checked with nfa_dfa_eol_match().
+ */
+    static void
+nfa_dfa_closure(prog, start, bol, eol)
+    nfa_regprog_T   *prog;
+    nfa_state_T	    *start;
+    int		    bol;
+    int		    eol;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+    nfa_state_T	**stack = dfa->dfa_stack;
+    int		sp = 0;
+    nfa_state_T	*state;
+    int		idx;
+
+    stack[sp++] = start;
+    while (sp > 0)
+    {
+	state = stack[--sp];
+	idx = (int)(state - prog->state);
+	if (dfa->dfa_mark[idx] == dfa->dfa_gen)
+	    continue;
+	dfa->dfa_mark[idx] = dfa->dfa_gen;
+
+	switch (state->c)
+	{
+	    case NFA_SPLIT:
+		/* Every state is expanded once, so the stack never holds more
+		 * than twice the number of states. */
+		stack[sp++] = state->out1;
+		stack[sp++] = state->out;
+		break;
+
+	    case NFA_BOL:
+		if (bol)
+		    stack[sp++] = state->out;
+		break;
+
+	    case NFA_EOL:
+		if (eol)
+		    stack[sp++] = state->out;
+		else
+		    dfa->dfa_work[dfa->dfa_nwork++] = idx;
+		break;
+
+	    case NFA_SKIP_CHAR:
+	    case NFA_ZSTART:
+	    case NFA_ZEND:
+	    case NFA_NOPEN:
+	    case NFA_NCLOSE:
+		stack[sp++] = state->out;
+		break;
+
+	    default:
+		if ((state->c >= NFA_MOPEN && state->c <= NFA_MCLOSE9)
+#ifdef FEAT_SYN_HL
+			|| (state->c >= NFA_ZOPEN && state->c <= NFA_ZCLOSE9)
+#endif
+		   )
+		    stack[sp++] = state->out;
+		else
+		    /* a character, class, collection or NFA_MATCH */
+		    dfa->dfa_work[dfa->dfa_nwork++] = idx;
+		break;
+	}
+    }
+}
+
+/*
+ * Return TRUE if NFA state "state" matches character "curc" with byte length
+ * "clen".  Must do the same as nfa_regmatch().
+ */
+    static int
+nfa_dfa_char_match(state, curc, clen)
+    nfa_state_T	    *state;
+    int		    curc;
+    int		    clen UNUSED;
+{
+    int		c = state->c;
+    int		result;
+
+    if (c > 0)
+    {
+	result = (c == curc);
+	if (!result && ireg_ic)
+	    result = MB_TOLOWER(c) == MB_TOLOWER(curc);
+#ifdef FEAT_MBYTE
+	/* A composing character only matches with NFA_COMPOSING. */
+	if (result && enc_utf8 && clen != utf_char2len(curc))
+	    result = FALSE;
+#endif
+	return result;
+    }
+    if (c == NFA_ANY)
+	return curc > 0;
+    if (c == NFA_START_COLL || c == NFA_START_NEG_COLL)
+	return curc != NUL && nfa_coll_match(state, curc);
+    return nfa_class_match(c, curc);
+}
+
+/*
+ * Compare function for sorting NFA state indexes.
+ */
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+nfa_dfa_compare(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    return *(int *)s1 - *(int *)s2;
+}
+
+/*
+ * Find the DFA state for the set that was built, add it when it doesn't
+ * exist yet.  Returns NULL when out of memory or when there are too many
+ * states.
+ */
+    static nfa_dstate_T *
+nfa_dfa_find_state(prog)
+    nfa_regprog_T   *prog;
+{
+    nfa_dfa_T	    *dfa = prog->dfa;
+    int		    n = dfa->dfa_nwork;
+    unsigned	    hash = 0;
+    int		    i;
+    nfa_dstate_T    *ds;
+
+    qsort((void *)dfa->dfa_work, (size_t)n, sizeof(int), nfa_dfa_compare);
+    for (i = 0; i < n; ++i)
+	hash = hash * 31 + (unsigned)dfa->dfa_work[i];
+
+    for (ds = dfa->dfa_hash[hash & (NFA_DFA_HASH_SIZE - 1)]; ds != NULL;
+							  ds = ds->ds_hnext)
+	if (ds->ds_hash == hash && ds->ds_count == n
+		&& memcmp(ds->ds_states, dfa->dfa_work, n * sizeof(int)) == 0)
+	    return ds;
+
+    if (dfa->dfa_count >= NFA_DFA_MAX_STATES
+				       || nfa_dfa_total >= NFA_DFA_MAX_TOTAL)
+	nfa_dfa_flush(dfa);
+    /* When other programs use up all states don't add any, the NFA is used
+     * then. */
+    if (nfa_dfa_total >= NFA_DFA_MAX_TOTAL)
+	return NULL;
+    ds = (nfa_dstate_T *)alloc_clear((unsigned)(sizeof(nfa_dstate_T)
+							 + n * sizeof(int)));
+    if (ds == NULL)
+	return NULL;
+    ds->ds_hash = hash;
+    ds->ds_count = n;
+    ds->ds_eol = -1;
+    for (i = 0; i < n; ++i)
+    {
+	ds->ds_states[i] = dfa->dfa_work[i];
+	if (prog->state[ds->ds_states[i]].c == NFA_MATCH)
+	    ds->ds_match = TRUE;
+    }
+    ds->ds_hnext = dfa->dfa_hash[hash & (NFA_DFA_HASH_SIZE - 1)];
+    dfa->dfa_hash[hash & (NFA_DFA_HASH_SIZE - 1)] = ds;
+    ++dfa->dfa_count;
+    ++nfa_dfa_total;
+    return ds;
+}
+
+/*
+ * Return the DFA state reached from "ds" with character "curc", which is
+ * "clen" bytes long.  Returns NULL when nfa_dfa_find_state() fails.
+ */
+    static nfa_dstate_T *
+nfa_dfa_step(prog, ds, curc, clen)
+    nfa_regprog_T   *prog;
+    nfa_dstate_T    *ds;
+    int		    curc;
+    int		    clen;
+{
+    nfa_dfa_T	    *dfa = prog->dfa;
+    nfa_state_T	    *state;
+    nfa_dstate_T    *next;
+    int		    i;
+
+    nfa_dfa_new_set(prog);
+    for (i = 0; i < ds->ds_count; ++i)
+    {
+	state = &prog->state[ds->ds_states[i]];
+	if (nfa_dfa_char_match(state, curc, clen))
+	    /* For a collection the next state is in out of the NFA_END_COLL,
+	     * out1 of the start points to the end. */
+	    nfa_dfa_closure(prog, state->c == NFA_START_COLL
+				       || state->c == NFA_START_NEG_COLL
+				       ? state->out1->out : state->out,
+							       FALSE, FALSE);
+    }
+    /* A match may also start at the next position. */
+    if (!prog->reganch)
+	nfa_dfa_closure(prog, prog->start, FALSE, FALSE);
+
+    dfa->dfa_flushed = FALSE;
+    next = nfa_dfa_find_state(prog);
+    /* Remember the transition for an ASCII character, unless "ds" was just
+     * freed. */
+    if (next != NULL && !dfa->dfa_flushed && clen == 1 && curc < 128)
+	ds->ds_next[curc] = next;
+    return next;
+}
+
+/*
+ * Return TRUE if "ds" matches at the end of the line.  "bol" is TRUE when
+ * this is also the start of the line.
+ */
+    static int
+nfa_dfa_eol_match(prog, ds, bol)
+    nfa_regprog_T   *prog;
+    nfa_dstate_T    *ds;
+    int		    bol;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+    int		i;
+
+    if (!bol && ds->ds_eol >= 0)
+	return ds->ds_eol;
+
+    nfa_dfa_new_set(prog);
+    for (i = 0; i < ds->ds_count; ++i)
+	if (prog->state[ds->ds_states[i]].c == NFA_EOL)
+	    nfa_dfa_closure(prog, prog->state[ds->ds_states[i]].out,
+								   bol, TRUE);
+    for (i = 0; i < dfa->dfa_nwork; ++i)
+	if (prog->state[dfa->dfa_work[i]].c == NFA_MATCH)
+	    break;
+    if (bol)
+	return i < dfa->dfa_nwork;
+    ds->ds_eol = i < dfa->dfa_nwork;
+    return ds->ds_eol;
+}
+
+/*
+ * Use the DFA of "prog" to check if there can be a match in "line" at or
+ * after column "col".  Returns FALSE if there certainly is no match, TRUE
+ * when there may be one.
+ */
+    static int
+nfa_dfa_may_match(prog, line, col)
+    nfa_regprog_T   *prog;
+    char_u	    *line;
+    colnr_T	    col;
+{
+    nfa_dfa_T	    *dfa = prog->dfa;
+    nfa_dstate_T    *ds;
+    nfa_dstate_T    *next;
+    char_u	    *p = line + col;
+    int		    bol = (col == 0);
+    int		    curc;
+    int		    clen;
+
+#ifdef FEAT_MBYTE
+    /* Folding composing characters is not handled. */
+    if (ireg_icombine)
+	return TRUE;
+#endif
+
+    if (dfa == NULL)
+    {
+	dfa = (nfa_dfa_T *)alloc_clear((unsigned)sizeof(nfa_dfa_T));
+	if (dfa == NULL)
+	{
+	    prog->dfa_ok = FALSE;
+	    return TRUE;
+	}
+	prog->dfa = dfa;
+	dfa->dfa_mark = (int *)alloc_clear(
+				       (unsigned)(prog->nstate * sizeof(int)));
+	dfa->dfa_work = (int *)alloc((unsigned)(prog->nstate * sizeof(int)));
+	dfa->dfa_stack = (nfa_state_T **)alloc(
+			   (unsigned)((prog->nstate * 2 + 1) * sizeof(nfa_state_T *)));
+	if (dfa->dfa_mark == NULL || dfa->dfa_work == NULL
+						   || dfa->dfa_stack == NULL)
+	{
+	    nfa_dfa_free(prog);
+	    prog->dfa_ok = FALSE;
+	    return TRUE;
+	}
+	dfa->dfa_ic = ireg_ic;
+    }
+    else if (dfa->dfa_ic != ireg_ic)
+    {
+	/* The states depend on ignoring case. */
+	nfa_dfa_flush(dfa);
+	dfa->dfa_ic = ireg_ic;
+    }
+
+    ds = dfa->dfa_start[bol];
+    if (ds == NULL)
+    {
+	nfa_dfa_new_set(prog);
+	nfa_dfa_closure(prog, prog->start, bol, FALSE);
+	ds = nfa_dfa_find_state(prog);
+	if (ds == NULL)
+	    return TRUE;
+	dfa->dfa_start[bol] = ds;
+    }
+
+    for (;;)
+    {
+	if (ds->ds_match)
+	    return TRUE;
+	curc = *p;
+	if (curc == NUL)
+	    return nfa_dfa_eol_match(prog, ds, p == line);
+
+	/* An ASCII character is one byte, unless a composing character
+	 * follows. */
+	if (curc < 128
+#ifdef FEAT_MBYTE
+		&& (!enc_utf8 || p[1] < 0x80)
+#endif
+		)
+	{
+	    next = ds->ds_next[curc];
+	    clen = 1;
+	}
+	else
+	{
+	    next = NULL;
+#ifdef FEAT_MBYTE
+	    if (has_mbyte)
+	    {
+		curc = (*mb_ptr2char)(p);
+		clen = (*mb_ptr2len)(p);
+	    }
+	    else
+#endif
+		clen = 1;
+	}
+	if (next == NULL)
+	{
+	    next = nfa_dfa_step(prog, ds, curc, clen);
+	    if (next == NULL)
+		return TRUE;
+	}
+	ds = next;
+	p += clen;
+    }
+}
+
 /*
  * Match a regexp against a string ("line" points to the string) or multiple
  * lines ("line" is NULL, use reg_getline()).
@@ -6532,6 +7161,15 @@ nfa_regexec_both(line, startcol)
     if (prog->reganch && col > 0)
 	return 0L;
 
+    /* If there is text that must appear, look for it.  Only when not
+     * ignoring case, folding may change the number of bytes. */
+    if (prog->regmust != NULL && !ireg_ic
+#ifdef FEAT_MBYTE
+	    && !ireg_icombine
+#endif
+	    && reg_find_must(line + col, prog->regmust, prog->regmlen) == NULL)
+	return 0L;
+
     need_clear_subexpr = TRUE;
 #ifdef FEAT_SYN_HL
     /* Clear the external match subpointers if necessary. */
@@ -6565,6 +7203,11 @@ nfa_regexec_both(line, startcol)
     if (ireg_maxcol > 0 && col >= ireg_maxcol)
 	goto theend;
 
+    /* When the DFA finds there is no match in the rest of the line there is
+     * no need to run the NFA. */
+    if (prog->dfa_ok && !nfa_dfa_may_match(prog, line, col))
+	goto theend;
+
     nstate = prog->nstate;
     for (i = 0; i < nstate; ++i)
     {
@@ -6669,6 +7312,10 @@ nfa_regcomp(expr, re_flags)
     prog->reganch = nfa_get_reganch(prog->start, 0);
     prog->regstart = nfa_get_regstart(prog->start, 0);
     prog->match_text = nfa_get_match_text(prog->start);
+    nfa_get_regmust(prog);
+    /* nfa_dfa_enable() may set dfa_ok later */
+    prog->dfa_ok = FALSE;
+    prog->dfa = NULL;
 
 #ifdef ENABLE_LOG
     nfa_postfix_dump(expr, OK);
@@ -6711,6 +7358,8 @@ nfa_regfree(prog)
     if (prog != NULL)
     {
 	vim_free(((nfa_regprog_T *)prog)->match_text);
+	vim_free(((nfa_regprog_T *)prog)->regmust);
+	nfa_dfa_free((nfa_regprog_T *)prog);
 #ifdef DEBUG
 	vim_free(((nfa_regprog_T *)prog)->pattern);
 #endif
@@ -556,6 +556,11 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 #ifdef FEAT_SEARCH_EXTRA
     int		break_loop = FALSE;
 #endif
+    char_u	*must;
+    int		mustlen = 0;
+    linenr_T	last;
+    linenr_T	next;
+    int		wrapped;
 
     if (search_regcomp(pat, RE_SEARCH, pat_use,
 		   (options & (SEARCH_HIS + SEARCH_KEEP)), &regmatch) == FAIL)
@@ -565,6 +570,9 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 	return FAIL;
     }
 
+    /* Text that every match contains, lines without it can be skipped. */
+    must = vim_regmust(&regmatch, &mustlen);
+
     /* When not accepting a match at the start position set "extra_col" to a
      * non-zero value.  Don't do that when starting at MAXCOL, since MAXCOL +
      * 1 is zero. */
@@ -633,6 +641,30 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 		    break;
 #endif
 
+		/* Go to the next line that contains "must", if any.  The
+		 * regexp would not match in the lines in between. */
+		if (must != NULL)
+		{
+		    last = dir == FORWARD ? buf->b_ml.ml_line_count : 1;
+		    if (stop_lnum != 0 && (dir == FORWARD
+				? stop_lnum < last : stop_lnum > last))
+			last = stop_lnum;
+		    /* In the second loop stop where started. */
+		    wrapped = loop && (dir == FORWARD
+			    ? start_pos.lnum >= lnum && start_pos.lnum <= last
+			    : start_pos.lnum <= lnum && start_pos.lnum >= last);
+		    if (wrapped)
+			last = start_pos.lnum;
+		    next = ml_find_text(buf, lnum, dir, last, must, mustlen);
+		    if (next != lnum)
+		    {
+			if (wrapped && next == last + dir)
+			    break;
+			lnum = next - dir;
+			continue;
+		    }
+		}
+
 		/*
 		 * Look for a match somewhere in line "lnum".
 		 */
@@ -434,6 +434,9 @@ typedef struct mf_hashtab_S
  * The used list is a doubly linked list, most recently used block first.
  *	The blocks in the used list have a block of memory allocated.
  *	mf_used_count is the number of pages in the used list.
+ *	When a block is to be released, one at the end of the list that was
+ *	found in the cache again (BH_REF) gets a second chance: it is moved
+ *	to the front instead.
  * The hash lists are used to quickly find a block in the used list.
  * The free list is a single linked list, not sorted.
  *	The blocks in the free list have no block of memory allocated and
@@ -449,10 +452,14 @@ struct block_hdr
     bhdr_T	*bh_prev;	    /* previous block_hdr in used list */
     char_u	*bh_data;	    /* pointer to memory (for used block) */
     int		bh_page_count;	    /* number of pages in this block */
+    long_u	bh_used;	    /* value of the use clock when inserted in
+				       the used list */
 
 #define BH_DIRTY    1
 #define BH_LOCKED   2
-    char	bh_flags;	    /* BH_DIRTY or BH_LOCKED */
+#define BH_REF	    4		    /* found in the cache since inserted in
+				       the used list */
+    char	bh_flags;	    /* BH_DIRTY, BH_LOCKED or BH_REF */
 };
 
 /*
@@ -567,6 +574,9 @@ struct memfile
     blocknr_T	mf_infile_count;	/* number of pages in the file */
     unsigned	mf_page_size;		/* number of bytes in a page */
     int		mf_dirty;		/* TRUE if there are dirty blocks */
+    long	mf_hits;		/* mf_get() found the block in memory */
+    long	mf_misses;		/* mf_get() read the block from file */
+    long	mf_evictions;		/* blocks released to make room */
 #ifdef FEAT_CRYPT
     buf_T	*mf_buffer;		/* bufer this memfile is for */
     char_u	mf_seed[MF_SEED_LEN];	/* seed for encryption */
@@ -595,6 +605,17 @@ typedef struct info_pointer
     int		ip_index;	/* index for block with current lnum */
 } infoptr_T;	/* block/index pair */
 
+/*
+ * Entry in the index of data blocks, used to find a line without going
+ * through the pointer blocks.
+ */
+typedef struct ml_index
+{
+    linenr_T	mi_low;		/* first line in the data block */
+    blocknr_T	mi_bnum;	/* data block number */
+    int		mi_page_count;	/* number of pages in the data block */
+} mlindex_T;
+
 #ifdef FEAT_BYTEOFF
 typedef struct ml_chunksize
 {
@@ -609,6 +630,35 @@ typedef struct ml_chunksize
 #define ML_CHNK_UPDLINE 3
 #endif
 
+/*
+ * A file that was mapped into memory by readfile() and whose lines are
+ * only copied out when needed.  See 'mmapsize'.
+ */
+typedef struct ml_map mlmap_T;
+
+#ifdef FEAT_MMAP_LOAD
+# define MLMAP_STEP	64	/* lines between entries in mm_index */
+# define MLMAP_LINES	4	/* number of returned lines kept valid */
+
+struct ml_map
+{
+    char_u	*mm_addr;	/* start of the mapping */
+    size_t	mm_size;	/* size of the mapping */
+    size_t	mm_len;		/* number of bytes used for text */
+    size_t	*mm_index;	/* offset of every MLMAP_STEP'th line */
+    linenr_T	mm_lines;	/* number of lines */
+    int		mm_fileformat;	/* EOL_UNIX or EOL_DOS */
+    int		mm_noeol;	/* last line has no end-of-line */
+    dev_t	mm_dev;		/* device of the mapped file */
+    ino_t	mm_ino;		/* inode of the mapped file */
+    linenr_T	mm_lnum;	/* last line looked up, 0 if none */
+    size_t	mm_off;		/* offset of "mm_lnum" */
+    char_u	*mm_line[MLMAP_LINES];	 /* copies of returned lines */
+    int		mm_linesize[MLMAP_LINES]; /* allocated size of mm_line[] */
+    int		mm_lineidx;	/* entry of mm_line[] used last */
+};
+#endif
+
 /*
  * the memline structure holds all the information about a memline
  */
@@ -622,6 +672,7 @@ typedef struct memline
 #define ML_LINE_DIRTY	2	/* cached line was changed and allocated */
 #define ML_LOCKED_DIRTY	4	/* ml_locked was changed */
 #define ML_LOCKED_POS	8	/* ml_locked needs positive block number */
+#define ML_LOCKED_NOSTACK 16	/* ml_locked was found without ml_stack */
     int		ml_flags;
 
     infoptr_T	*ml_stack;	/* stack of pointer blocks (array of IPTRs) */
@@ -635,10 +686,28 @@ typedef struct memline
     linenr_T	ml_locked_low;	/* first line in ml_locked */
     linenr_T	ml_locked_high;	/* last line in ml_locked */
     int		ml_locked_lineadd;  /* number of lines inserted in ml_locked */
+
+    mlindex_T	*ml_index;	/* all data blocks, in line number order */
+    int		ml_index_len;	/* number of entries used, zero if invalid */
+    int		ml_index_size;	/* number of entries allocated */
+
+    /* statistics for ml_find_line(), see memlinestats() */
+    long	ml_find_locked;	/* line was in ml_locked */
+    long	ml_find_stack;	/* found through ml_stack */
+    long	ml_find_index;	/* found through ml_index */
+    long	ml_find_root;	/* searched from the root of the tree */
+    long	ml_root_count;	/* ml_find_root since ml_index was invalid */
 #ifdef FEAT_BYTEOFF
     chunksize_T *ml_chunksize;
     int		ml_numchunks;
     int		ml_usedchunks;
+    chunksize_T *ml_chunktree;	/* sums of ml_chunksize entries in a Fenwick
+				   tree, for finding a chunk quickly */
+    int		ml_chunktree_size;  /* number of entries in ml_chunktree */
+    int		ml_chunktree_ok;    /* ml_chunktree matches ml_chunksize */
+#endif
+#ifdef FEAT_MMAP_LOAD
+    mlmap_T	*ml_map;	/* mapped file the lines come from, or NULL */
 #endif
 } memline_T;
 
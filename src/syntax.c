@@ -426,7 +426,7 @@ static void limit_pos_zero __ARGS((lpos_T *pos, lpos_T *limit));
 static void syn_add_end_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpat_T *spp, int idx, int extra));
 static void syn_add_start_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpat_T *spp, int idx, int extra));
 static char_u *syn_getcurline __ARGS((void));
-static int syn_regexec __ARGS((regmmatch_T *rmp, linenr_T lnum, colnr_T col, syn_time_T *st));
+static int syn_regexec __ARGS((regmmatch_T *rmp, linenr_T lnum, colnr_T col, syn_time_T *st, int id));
 static int check_keyword_id __ARGS((char_u *line, int startcol, int *endcol, long *flags, short **next_list, stateitem_T *cur_si, int *ccharp));
 static void syn_cmd_case __ARGS((exarg_T *eap, int syncing));
 static void syn_cmd_spell __ARGS((exarg_T *eap, int syncing));
@@ -998,7 +998,7 @@ syn_match_linecont(lnum)
 	regmatch.rmm_ic = syn_block->b_syn_linecont_ic;
 	regmatch.regprog = syn_block->b_syn_linecont_prog;
 	return syn_regexec(&regmatch, lnum, (colnr_T)0,
-				IF_SYN_TIME(&syn_block->b_syn_linecont_time));
+				IF_SYN_TIME(&syn_block->b_syn_linecont_time), 0);
     }
     return FALSE;
 }
@@ -2092,7 +2092,8 @@ syn_current_attr(syncing, displaying, can_spell, keep_state)
 			    if (!syn_regexec(&regmatch,
 					     current_lnum,
 					     (colnr_T)lc_col,
-				             IF_SYN_TIME(&spp->sp_time)))
+				             IF_SYN_TIME(&spp->sp_time),
+					     spp->sp_syn.id))
 			    {
 				/* no match in this line, try another one */
 				spp->sp_startcol = MAXCOL;
@@ -2974,7 +2975,7 @@ find_endpos(idx, startpos, m_endpos, hl_endpos, flagsp, end_endpos,
 	    regmatch.rmm_ic = spp->sp_ic;
 	    regmatch.regprog = spp->sp_prog;
 	    if (syn_regexec(&regmatch, startpos->lnum, lc_col,
-						  IF_SYN_TIME(&spp->sp_time)))
+				      IF_SYN_TIME(&spp->sp_time), spp->sp_syn.id))
 	    {
 		if (best_idx == -1 || regmatch.startpos[0].col
 					      < best_regmatch.startpos[0].col)
@@ -3006,7 +3007,7 @@ find_endpos(idx, startpos, m_endpos, hl_endpos, flagsp, end_endpos,
 	    regmatch.rmm_ic = spp_skip->sp_ic;
 	    regmatch.regprog = spp_skip->sp_prog;
 	    if (syn_regexec(&regmatch, startpos->lnum, lc_col,
-					      IF_SYN_TIME(&spp_skip->sp_time))
+			   IF_SYN_TIME(&spp_skip->sp_time), spp_skip->sp_syn.id)
 		    && regmatch.startpos[0].col
 					     <= best_regmatch.startpos[0].col)
 	    {
@@ -3251,14 +3252,17 @@ syn_getcurline()
 
 /*
  * Call vim_regexec() to find a match with "rmp" in "syn_buf".
+ * "id" is the syntax group the pattern is used for, zero for a "linecont"
+ * pattern.
  * Returns TRUE when there is a match.
  */
     static int
-syn_regexec(rmp, lnum, col, st)
+syn_regexec(rmp, lnum, col, st, id)
     regmmatch_T	*rmp;
     linenr_T	lnum;
     colnr_T	col;
     syn_time_T  *st UNUSED;
+    int		id UNUSED;
 {
     int r;
 #ifdef FEAT_PROFILE
@@ -3266,12 +3270,14 @@ syn_regexec(rmp, lnum, col, st)
 
     if (syn_time_on)
 	profile_start(&pt);
+    regtime_id = id;	/* for ":regtime report" */
 #endif
 
     rmp->rmm_maxcol = syn_buf->b_p_smc;
     r = vim_regexec_multi(rmp, syn_win, syn_buf, lnum, col, NULL);
 
 #ifdef FEAT_PROFILE
+    regtime_id = 0;
     if (syn_time_on)
     {
 	profile_end(&pt);
@@ -9169,7 +9175,7 @@ highlight_exists(name)
     return (syn_name2id(name) > 0);
 }
 
-# if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+# if defined(FEAT_SEARCH_EXTRA) || defined(FEAT_PROFILE) || defined(PROTO)
 /*
  * Return the name of highlight group "id".
  * When not a valid ID return an empty string.
@@ -52,7 +52,8 @@ SCRIPTS =	test3.out test4.out test5.out test6.out test7.out \
 		test79.out test80.out test81.out test82.out test83.out \
 		test84.out test85.out test86.out test87.out test88.out \
 		test89.out test90.out test91.out test92.out test93.out \
-		test94.out test95.out test96.out test98.out
+		test94.out test95.out test96.out test98.out \
+		test99.out test100.out test101.out test102.out test103.out test104.out
 
 SCRIPTS32 =	test50.out test70.out
 
@@ -0,0 +1,45 @@
+" Benchmark for finding the byte offset of a line and the line at a byte
+" offset, as used by line2byte(), byte2line(), ":goto" and "%o" in
+" 'statusline'.
+"
+" Run it with "make benchmark" in the src directory.  $BENCH_LINES sets the
+" number of lines in the buffer (default 3000000).  The results are appended
+" to benchmark.out.
+
+set nocp noswapfile noundofile nomore
+let s:lines = empty($BENCH_LINES) ? 3000000 : str2nr($BENCH_LINES)
+let s:count = 100000
+let s:results = []
+
+func s:Report(name, start)
+  let secs = str2float(reltimestr(reltime(a:start)))
+  call add(s:results, printf('%-10s %8d lines  %7.3f sec  %7.2f usec/call',
+	\ a:name, line('$'), secs, secs * 1000000 / s:count))
+endfunc
+
+call setline(1, map(range(1, s:lines), '"line " . v:val'))
+let s:total = line2byte(line('$') + 1)
+
+let s:start = reltime()
+for s:i in range(s:count)
+  call line2byte((s:i * 7919) % s:lines + 1)
+endfor
+call s:Report('line2byte', s:start)
+
+let s:start = reltime()
+for s:i in range(s:count)
+  call byte2line((s:i * 104729) % s:total + 1)
+endfor
+call s:Report('byte2line', s:start)
+
+" Inserting lines all over the buffer updates the offsets.
+let s:start = reltime()
+for s:i in range(s:count)
+  call append((s:i * 7919) % s:lines, 'new')
+  call line2byte((s:i * 104729) % s:lines + 1)
+endfor
+call s:Report('append', s:start)
+
+call writefile((filereadable('benchmark.out') ? readfile('benchmark.out') : [])
+      \ + s:results, 'benchmark.out')
+qa!
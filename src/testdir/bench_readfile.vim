@@ -0,0 +1,72 @@
+" Benchmark for reading big files into a buffer.
+"
+" Run it with "make benchmark" in the src directory.  The files are generated
+" in the current directory, $BENCH_MBYTE sets their size in Mbyte (default
+" 256).  Use a few thousand to measure multi-Gbyte files.  The results are
+" appended to benchmark.out.
+
+set nocp noswapfile noundofile nomore enc=utf-8
+scriptencoding utf-8
+let s:mbyte = empty($BENCH_MBYTE) ? 256 : str2nr($BENCH_MBYTE)
+let s:results = []
+
+" Write a file of "s:mbyte" Mbyte by repeating a block of about one Mbyte
+" made of "line" with a line number in front.  The optional argument is the
+" 'fileencoding' to use.
+func s:MakeFile(fname, line, ff, ...)
+  enew!
+  let &l:ff = a:ff
+  let &l:fenc = a:0 > 0 ? a:1 : ''
+  let lines = []
+  let size = 0
+  while size < 1024 * 1024
+    let l = len(lines) . ',' . a:line
+    call add(lines, l)
+    let size += len(l) + 1
+  endwhile
+  call setline(1, lines)
+  for i in range(s:mbyte)
+    " Appending only works for an existing file.
+    exe 'silent w' . (i == 0 ? '! ' : ' >> ') . a:fname
+  endfor
+  enew!
+endfunc
+
+" Edit "fname" with 'fileencodings' set to "fencs", report the time it took.
+" The optional argument is the encoding to use with ++enc.
+func s:Bench(name, fname, fencs, ...)
+  let &fencs = a:fencs
+  let start = reltime()
+  exe 'silent e! ' . (a:0 > 0 ? '++enc=' . a:1 . ' ' : '') . a:fname
+  let secs = str2float(reltimestr(reltime(start)))
+  call add(s:results, printf('%-8s %8d lines  %7.3f sec  %7.1f Mbyte/sec',
+	\ a:name, line('$'), secs, s:mbyte / (secs > 0 ? secs : 0.001)))
+  enew!
+  exe 'bwipe! ' . a:fname
+endfunc
+
+call s:MakeFile('Xbench_csv', 'field one,field two,3.1415,"quoted, text",end', 'unix')
+call s:MakeFile('Xbench_dos', '2015-01-01 12:00:00 INFO server: request done in 12 ms', 'dos')
+call s:MakeFile('Xbench_utf8', 'naïve café,größe,日本語のテキスト,ok', 'unix')
+call s:MakeFile('Xbench_latin1', 'naïve café,größe,field two,3.1415,end', 'unix', 'latin1')
+call s:MakeFile('Xbench_utf16', 'naïve café,größe,field two,3.1415,end', 'unix', 'utf-16le')
+
+call s:Bench('csv', 'Xbench_csv', '')
+call s:Bench('dos', 'Xbench_dos', 'ucs-bom,utf-8,default,latin1')
+call s:Bench('utf-8', 'Xbench_utf8', 'ucs-bom,utf-8,default,latin1')
+call s:Bench('latin1', 'Xbench_latin1', 'ucs-bom,utf-8,default,latin1')
+call s:Bench('utf-16', 'Xbench_utf16', '', 'utf-16le')
+if has('mmap_load')
+  set mms=1
+  call s:Bench('mapped', 'Xbench_csv', '')
+  set mms=0
+endif
+
+call delete('Xbench_csv')
+call delete('Xbench_dos')
+call delete('Xbench_utf8')
+call delete('Xbench_latin1')
+call delete('Xbench_utf16')
+call writefile((filereadable('benchmark.out') ? readfile('benchmark.out') : [])
+      \ + s:results, 'benchmark.out')
+qa!
@@ -0,0 +1,41 @@
+" Benchmark for writing a big buffer to a file.
+"
+" Run it with "make benchmark" in the src directory.  The file is written in
+" the current directory, $BENCH_MBYTE sets its size in Mbyte (default 128).
+" The results are appended to benchmark.out.
+
+set nocp noswapfile noundofile nomore enc=utf-8
+let s:mbyte = empty($BENCH_MBYTE) ? 128 : str2nr($BENCH_MBYTE)
+let s:results = []
+
+" Write the buffer with 'fileformat' "ff" and 'fileencoding' "fenc", report
+" the time it took.
+func s:Bench(name, ff, fenc, ...)
+  let &ff = a:ff
+  let &fenc = a:fenc
+  let &backup = a:0 > 0
+  let start = reltime()
+  silent w! Xbench_write
+  let secs = str2float(reltimestr(reltime(start)))
+  call add(s:results, printf('%-8s %8d lines  %7.3f sec  %7.1f Mbyte/sec',
+	\ a:name, line('$'), secs, s:mbyte / (secs > 0 ? secs : 0.001)))
+endfunc
+
+let s:lines = map(range(20000), 'v:val . ",field one,field two,3.1415,end"')
+call setline(1, s:lines)
+while line2byte(line('$') + 1) < s:mbyte * 1024 * 1024
+  call append('$', s:lines)
+endwhile
+
+call s:Bench('unix', 'unix', '')
+call s:Bench('dos', 'dos', '')
+call s:Bench('latin1', 'unix', 'latin1')
+call s:Bench('ucs-2', 'unix', 'ucs-2')
+set backupdir=. backupext=.bak backupskip= backupcopy=yes
+call s:Bench('backup', 'unix', '', 1)
+
+call delete('Xbench_write')
+call delete('Xbench_write.bak')
+call writefile((filereadable('benchmark.out') ? readfile('benchmark.out') : [])
+      \ + s:results, 'benchmark.out')
+qa!
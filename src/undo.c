@@ -740,6 +740,22 @@ u_compute_hash(hash)
 u_get_undo_file_name(buf_ffname, reading)
     char_u	*buf_ffname;
     int		reading;
+{
+    return u_get_udir_file_name(buf_ffname, reading, (char_u *)".un~",
+							      (char_u *)"");
+}
+
+/*
+ * Like u_get_undo_file_name(), for another kind of file kept in 'undodir'.
+ * "dot_ext" is appended for the "." entry: "dir/name" -> "dir/.name.un~".
+ * "dir_ext" is appended to the munged file name for other directories.
+ */
+    char_u *
+u_get_udir_file_name(buf_ffname, reading, dot_ext, dir_ext)
+    char_u	*buf_ffname;
+    int		reading;
+    char_u	*dot_ext;
+    char_u	*dir_ext;
 {
     char_u	*dirp;
     char_u	dir_name[IOSIZE + 1];
@@ -773,13 +789,14 @@ u_get_undo_file_name(buf_ffname, reading)
 	{
 	    /* Use same directory as the ffname,
 	     * "dir/name" -> "dir/.name.un~" */
-	    undo_file_name = vim_strnsave(ffname, (int)(STRLEN(ffname) + 5));
+	    undo_file_name = vim_strnsave(ffname,
+				  (int)(STRLEN(ffname) + STRLEN(dot_ext) + 1));
 	    if (undo_file_name == NULL)
 		break;
 	    p = gettail(undo_file_name);
 	    mch_memmove(p + 1, p, STRLEN(p) + 1);
 	    *p = '.';
-	    STRCAT(p, ".un~");
+	    STRCAT(p, dot_ext);
 	}
 	else
 	{
@@ -788,7 +805,7 @@ u_get_undo_file_name(buf_ffname, reading)
 	    {
 		if (munged_name == NULL)
 		{
-		    munged_name = vim_strsave(ffname);
+		    munged_name = concat_str(ffname, dir_ext);
 		    if (munged_name == NULL)
 			return NULL;
 		    for (p = munged_name; *p != NUL; mb_ptr_adv(p))
@@ -335,6 +335,11 @@ static char *(features[]) =
 #else
 	"-mksession",
 #endif
+#ifdef FEAT_MMAP_LOAD
+	"+mmap_load",
+#else
+	"-mmap_load",
+#endif
 #ifdef FEAT_MODIFY_FNAME
 	"+modify_fname",
 #else